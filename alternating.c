@@ -41,7 +41,8 @@ char **sym_table;
 ATrans **transition;
 struct rusage tr_debut, tr_fin;
 struct timeval t_diff;
-int *final_set, node_id = 1, sym_id = 0, node_size, sym_size;
+uint64_t *final_set;
+int node_id = 1, sym_id = 0, node_size, sym_size;
 int astate_count = 0, atrans_count = 0;
 
 ATrans *build_alternating(Node *p);
@@ -94,9 +95,7 @@ ATrans *dup_trans(ATrans *trans) /* returns the copy of a transition */
   if (!trans)
     return trans;
   result = emalloc_atrans();
-  copy_set(trans->to, result->to, 0);
-  copy_set(trans->pos, result->pos, 1);
-  copy_set(trans->neg, result->neg, 1);
+  copy_set(trans->pos, result->pos, LABEL_NODES);
   return result;
 }
 
@@ -109,9 +108,7 @@ void do_merge_trans(ATrans **result, ATrans *trans1,
   }
   if (!*result)
     *result = emalloc_atrans();
-  do_merge_sets((*result)->to, trans1->to, trans2->to, 0);
-  do_merge_sets((*result)->pos, trans1->pos, trans2->pos, 1);
-  do_merge_sets((*result)->neg, trans1->neg, trans2->neg, 1);
+  do_merge_sets((*result)->pos, trans1->pos, trans2->pos, LABEL_NODES);
   if (!empty_intersect_sets((*result)->pos, (*result)->neg, 1)) {
     free_atrans(*result, 0);
     *result = (ATrans *)0;
@@ -151,9 +148,7 @@ boolean(Node *p) /* computes the transitions to boolean nodes -> next & init */
   switch (p->ntyp) {
   case TRUE:
     result = emalloc_atrans();
-    clear_set(result->to, 0);
-    clear_set(result->pos, 1);
-    clear_set(result->neg, 1);
+    clear_set(result->pos, LABEL_NODES);
   case FALSE:
     break;
   case AND:
@@ -190,9 +185,7 @@ boolean(Node *p) /* computes the transitions to boolean nodes -> next & init */
   default:
     build_alternating(p);
     result = emalloc_atrans();
-    clear_set(result->to, 0);
-    clear_set(result->pos, 1);
-    clear_set(result->neg, 1);
+    clear_set(result->pos, LABEL_NODES);
     add_set(result->to, already_done(p));
   }
   return result;
@@ -209,25 +202,19 @@ ATrans *build_alternating(Node *p) /* builds an alternating automaton for p */
 
   case TRUE:
     t = emalloc_atrans();
-    clear_set(t->to, 0);
-    clear_set(t->pos, 1);
-    clear_set(t->neg, 1);
+    clear_set(t->pos, LABEL_NODES);
   case FALSE:
     break;
 
   case PREDICATE:
     t = emalloc_atrans();
-    clear_set(t->to, 0);
-    clear_set(t->pos, 1);
-    clear_set(t->neg, 1);
+    clear_set(t->pos, LABEL_NODES);
     add_set(t->pos, get_sym_id(p->sym->name));
     break;
 
   case NOT:
     t = emalloc_atrans();
-    clear_set(t->to, 0);
-    clear_set(t->pos, 1);
-    clear_set(t->neg, 1);
+    clear_set(t->pos, LABEL_NODES);
     add_set(t->neg, get_sym_id(p->lft->sym->name));
     break;
 
@@ -317,8 +304,7 @@ void simplify_atrans(ATrans **trans) /* simplifies the transitions */
   for (t = *trans; t;) {
     ATrans *t1;
     for (t1 = *trans; t1; t1 = t1->nxt) {
-      if ((t1 != t) && included_set(t1->to, t->to, 0) &&
-          included_set(t1->pos, t->pos, 1) && included_set(t1->neg, t->neg, 1))
+      if ((t1 != t) && included_set(t1->pos, t->pos, LABEL_NODES))
         break;
     }
     if (t1) {
@@ -342,7 +328,8 @@ void simplify_atrans(ATrans **trans) /* simplifies the transitions */
 void simplify_astates() /* simplifies the alternating automaton */
 {
   ATrans *t;
-  int i, *acc = make_set(-1, 0); /* no state is accessible initially */
+  int i;
+  uint64_t *acc = make_set(-1, 0); /* no state is accessible initially */
 
   for (t = transition[0]; t; t = t->nxt, i = 0)
     merge_sets(acc, t->to, 0); /* all initial states are accessible */
@@ -360,7 +347,7 @@ void simplify_astates() /* simplifies the alternating automaton */
       merge_sets(acc, t->to, 0);
   }
 
-  tfree(acc);
+  free_set(acc, 0);
 }
 
 /********************************************************************\
@@ -411,12 +398,16 @@ void mk_alternating(Node *p) /* generates an alternating automaton for p */
       calculate_node_size(p) + 1; /* number of states in the automaton */
   label = (Node **)tl_emalloc(node_size * sizeof(Node *));
   transition = (ATrans **)tl_emalloc(node_size * sizeof(ATrans *));
-  node_size = node_size / (8 * sizeof(int)) + 1;
+  node_size = node_size / (8 * sizeof(uint64_t)) + 1;
 
   sym_size = calculate_sym_size(p); /* number of predicates */
   if (sym_size)
     sym_table = (char **)tl_emalloc(sym_size * sizeof(char *));
-  sym_size = sym_size / (8 * sizeof(int)) + 1;
+  sym_size = sym_size / (8 * sizeof(uint64_t)) + 1;
+  init_set_ops(0);
+  init_set_ops(1);
+  init_set_ops(LABEL);
+  init_set_ops(LABEL_NODES);
 
   final_set = make_set(-1, 0);
   transition[0] = boolean(p); /* generates the alternating automaton */
@@ -41,15 +41,26 @@ extern GState **init, *gstates;
 extern struct rusage tr_debut, tr_fin;
 extern struct timeval t_diff;
 extern int tl_verbose, tl_stats, tl_simp_diff, tl_simp_fly, tl_simp_scc,
-    init_size, *final;
+    tl_degen_scc, tl_simp_sim, init_size, *final, sym_size, final_mask,
+    sym_id;
+extern uint64_t *bad_scc;
 
 extern int gstate_id;
+extern char **sym_table;
 
 extern FILE *tl_out;
 BState *bstack, *bstates, *bremoved;
-static BScc *scc_stack;
+static BScc *bdfs_stack;
+static BState **scc_stack;
+static int bdfs_depth, scc_top;
 int accept, bstate_count = 0, btrans_count = 0;
-static int rank;
+static int rank, *bkey, bsig_size;
+static BState **bindex; /* states by gstate and final, see find_bstate */
+static int bindex_size, bindex_count;
+static unsigned long *bsig_buf;
+static BState **bwork; /* states changed since the last simplify_btrans */
+static int bwork_count, bwork_size;
+static int bpass, btrans_mark, bstates_mark, bround, bvisit, bcompare;
 
 /********************************************************************\
 |*        Simplification of the generalized Buchi automaton         *|
@@ -58,7 +69,7 @@ static int rank;
 void free_bstate(BState *s) /* frees a state and its transitions */
 {
   free_btrans(s->trans->nxt, s->trans, 1);
-  tfree(s);
+  slab_free(s, sizeof(BState));
 }
 
 BState *remove_bstate(BState *s, BState *s1) /* removes a state */
@@ -70,49 +81,104 @@ BState *remove_bstate(BState *s, BState *s1) /* removes a state */
   s->trans = (BTrans *)0;
   s->nxt = bremoved->nxt;
   bremoved->nxt = s;
-  s->prv = s1;
-  for (s1 = bremoved->nxt; s1 != bremoved; s1 = s1->nxt)
-    if (s1->prv == s)
-      s1->prv = s->prv;
+  s->prv = s1; /* s now redirects to s1, see redirect_bstate */
   return prv;
 }
 
+BState *redirect_bstate(BState *s) /* finds the state replacing s, following
+                                      the removed states (union-find) */
+{
+  BState *root = s, *nxt;
+  while (root && !root->trans) /* root has been removed */
+    root = root->prv;
+  while (s != root) { /* path compression */
+    nxt = s->prv;
+    s->prv = root;
+    s = nxt;
+  }
+  return root;
+}
+
+void touch_bstate(BState *s) /* records that a state has changed, and puts
+                                 it in the worklist */
+{
+  if (s->dirty <= btrans_mark) { /* not in the worklist */
+    if (bwork_count == bwork_size) {
+      BState **tmp =
+          (BState **)tl_emalloc(2 * (bwork_size + 1) * sizeof(BState *));
+      if (bwork) {
+        memcpy(tmp, bwork, bwork_size * sizeof(BState *));
+        tfree(bwork);
+      }
+      bwork = tmp;
+      bwork_size = 2 * (bwork_size + 1);
+    }
+    bwork[bwork_count++] = s;
+  }
+  s->dirty = bpass;
+}
+
+void add_bpred(BState *s, BState *p) /* p has a transition to s */
+{
+  BPred *e;
+  if (s->pred && s->pred->bstate == p)
+    return;
+  e = (BPred *)slab_alloc(sizeof(BPred));
+  e->bstate = p;
+  e->nxt = s->pred;
+  s->pred = e;
+}
+
+void free_bpred(BState *s) {
+  BPred *e;
+  while ((e = s->pred)) {
+    s->pred = e->nxt;
+    slab_free(e, sizeof(BPred));
+  }
+}
+
 void copy_btrans(BTrans *from, BTrans *to) {
   to->to = from->to;
-  copy_set(from->pos, to->pos, 1);
-  copy_set(from->neg, to->neg, 1);
+  to->pos = from->pos;
+  to->neg = from->neg;
+  to->label = from->label;
 }
 
-int simplify_btrans() /* simplifies the transitions */
+int simplify_btrans() /* simplifies the transitions of the states in the
+                         worklist */
 {
   BState *s;
   BTrans *t, *t1;
-  int changed = 0;
+  int changed = 0, i, n = bwork_count;
 
   if (tl_stats)
     getrusage(RUSAGE_SELF, &tr_debut);
 
-  for (s = bstates->nxt; s != bstates; s = s->nxt)
+  btrans_mark = ++bpass;
+  for (i = 0; i < n; i++) {
+    if (!(s = bwork[i])->trans) /* s has been removed */
+      continue;
+    bvisit++;
     for (t = s->trans->nxt; t != s->trans;) {
       t1 = s->trans->nxt;
       copy_btrans(t, s->trans);
       while ((t == t1) || (t->to != t1->to) ||
-             !included_set(t1->pos, t->pos, 1) ||
-             !included_set(t1->neg, t->neg, 1))
+             !included_label(t1->label, t->label))
         t1 = t1->nxt;
       if (t1 != s->trans) {
         BTrans *free = t->nxt;
-        t->to = free->to;
-        copy_set(free->pos, t->pos, 1);
-        copy_set(free->neg, t->neg, 1);
+        copy_btrans(free, t);
         t->nxt = free->nxt;
         if (free == s->trans)
           s->trans = t;
         free_btrans(free, 0, 0);
+        touch_bstate(s);
         changed++;
       } else
         t = t->nxt;
     }
+  }
+  bwork_count = 0;
 
   if (tl_stats) {
     getrusage(RUSAGE_SELF, &tr_fin);
@@ -128,8 +194,7 @@ int simplify_btrans() /* simplifies the transitions */
 int same_btrans(BTrans *s,
                 BTrans *t) /* returns 1 if the transitions are identical */
 {
-  return ((s->to == t->to) && same_sets(s->pos, t->pos, 1) &&
-          same_sets(s->neg, t->neg, 1));
+  return ((s->to == t->to) && s->label == t->label);
 }
 
 void remove_btrans(BState *to) { /* redirects transitions before removing a
@@ -140,40 +205,87 @@ void remove_btrans(BState *to) { /* redirects transitions before removing a
     for (t = s->trans->nxt; t != s->trans; t = t->nxt)
       if (t->to == to) { /* transition to a state with no transitions */
         BTrans *free = t->nxt;
-        t->to = free->to;
-        copy_set(free->pos, t->pos, 1);
-        copy_set(free->neg, t->neg, 1);
+        copy_btrans(free, t);
+        t->nxt = free->nxt;
+        if (free == s->trans)
+          s->trans = t;
+        free_btrans(free, 0, 0);
+      }
+}
+
+int retarget_btrans(BState *s, int pred) { /* redirects the transitions of s
+                                              to removed states */
+  BTrans *t;
+  int changed = 0;
+  for (t = s->trans->nxt; t != s->trans;)
+    if (!t->to->trans) { /* t->to has been removed */
+      changed = 1;
+      t->to = redirect_bstate(t->to);
+      if (!t->to) { /* t->to has no transitions */
+        BTrans *free = t->nxt;
+        copy_btrans(free, t);
         t->nxt = free->nxt;
         if (free == s->trans)
           s->trans = t;
         free_btrans(free, 0, 0);
+      } else {
+        if (pred)
+          add_bpred(t->to, s);
+        t = t->nxt;
       }
+    } else
+      t = t->nxt;
+  return changed;
+}
+
+void free_bremoved() { /* clean the 'removed' list */
+  BState *s;
+  while (bremoved->nxt != bremoved) {
+    s = bremoved->nxt;
+    bremoved->nxt = bremoved->nxt->nxt;
+    free_bpred(s);
+    slab_free(s, sizeof(BState));
+  }
 }
 
 void retarget_all_btrans() { /* redirects transitions before removing a state
                                 from the automaton */
   BState *s;
-  BTrans *t;
   for (s = bstates->nxt; s != bstates; s = s->nxt)
-    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
-      if (!t->to->trans) { /* t->to has been removed */
-        t->to = t->to->prv;
-        if (!t->to) { /* t->to has no transitions */
-          BTrans *free = t->nxt;
-          t->to = free->to;
-          copy_set(free->pos, t->pos, 1);
-          copy_set(free->neg, t->neg, 1);
-          t->nxt = free->nxt;
-          if (free == s->trans)
-            s->trans = t;
-          free_btrans(free, 0, 0);
-        }
+    retarget_btrans(s, 0);
+  free_bremoved();
+}
+
+static int cmp_hash(const void *x, const void *y) {
+  unsigned long a = *(const unsigned long *)x, b = *(const unsigned long *)y;
+  return (a > b) - (a < b);
+}
+
+unsigned long bstate_signature(BState *s) { /* hashes the labels and targets
+                                               of the transitions of a state */
+  BTrans *t;
+  int i, n = 0;
+  unsigned long h = 0;
+  for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+    if (n == bsig_size) { /* the buffer is full */
+      unsigned long *tmp = (unsigned long *)tl_emalloc(
+          2 * (bsig_size + 1) * sizeof(unsigned long));
+      if (bsig_buf) {
+        memcpy(tmp, bsig_buf, bsig_size * sizeof(unsigned long));
+        tfree(bsig_buf);
       }
-  while (bremoved->nxt != bremoved) { /* clean the 'removed' list */
-    s = bremoved->nxt;
-    bremoved->nxt = bremoved->nxt->nxt;
-    tfree(s);
+      bsig_buf = tmp;
+      bsig_size = 2 * (bsig_size + 1);
+    }
+    bsig_buf[n] = label_hash(t->label) * 31 +
+                  (unsigned long)t->to; /* ids may change */
+    n++;
   }
+  qsort(bsig_buf, n, sizeof(unsigned long), cmp_hash);
+  for (i = 0; i < n; i++)
+    if (i == 0 || bsig_buf[i] != bsig_buf[i - 1]) /* a set, not a multiset */
+      h = (h ^ bsig_buf[i]) * 1099511628211UL;
+  return h;
 }
 
 int all_btrans_match(BState *a,
@@ -217,24 +329,47 @@ int all_btrans_match(BState *a,
 
 int simplify_bstates() /* eliminates redundant states */
 {
-  BState *s, *s1, *s2;
-  int changed = 0;
+  BState *s, *s1, *s2, **order, *removed = bremoved->nxt;
+  BPred *p;
+  int changed = 0, i, j, n, size, mark = bstates_mark, *next, *bucket;
 
   if (tl_stats)
     getrusage(RUSAGE_SELF, &tr_debut);
 
-  for (s = bstates->nxt; s != bstates; s = s->nxt) {
+  /* equivalent states have the same signature: only the states of the same
+     bucket, later in the list, are compared with all_btrans_match; two states
+     that have not changed since the last call have already been compared */
+  bstates_mark = ++bpass;
+  for (n = 0, s = bstates->nxt; s != bstates; s = s->nxt)
+    n++;
+  for (size = 1; size < n; size *= 2)
+    ;
+  order = (BState **)tl_emalloc((n + 1) * sizeof(BState *));
+  next = (int *)tl_emalloc((n + 1) * sizeof(int));
+  bucket = (int *)tl_emalloc(size * sizeof(int));
+  for (i = 0, s = bstates->nxt; s != bstates; s = s->nxt, i++) {
+    order[i] = s;
+    if (s->dirty >= mark)
+      s->sig = bstate_signature(s);
+  }
+  for (i = n - 1; i >= 0; i--) { /* buckets list the states in order */
+    next[i] = bucket[order[i]->sig & (size - 1)];
+    bucket[order[i]->sig & (size - 1)] = i + 1;
+  }
+
+  for (i = 0; i < n; i++) {
+    s = order[i];
     if (s->trans == s->trans->nxt) { /* s has no transitions */
-      s = remove_bstate(s, (BState *)0);
+      remove_bstate(s, (BState *)0);
       changed++;
       continue;
     }
-    bstates->trans = s->trans;
-    bstates->final = s->final;
-    s1 = s->nxt;
-    while (!all_btrans_match(s, s1))
-      s1 = s1->nxt;
-    if (s1 != bstates) { /* s and s1 are equivalent */
+    for (j = next[i]; j; j = next[j - 1])
+      if ((s1 = order[j - 1])->sig == s->sig &&
+          (s->dirty >= mark || s1->dirty >= mark) && ++bcompare &&
+          all_btrans_match(s, s1))
+        break;
+    if (j) { /* s and s1 are equivalent */
       /* we now want to remove s and replace it by s1 */
       if (s1->incoming == -1) { /* s1 is in a trivial SCC */
         s1->final =
@@ -264,11 +399,20 @@ int simplify_bstates() /* eliminates redundant states */
          */
         s1->incoming = s->incoming;
       }
-      s = remove_bstate(s, s1);
+      touch_bstate(s1);
+      remove_bstate(s, s1);
       changed++;
     }
   }
-  retarget_all_btrans();
+  tfree(order);
+  tfree(next);
+  tfree(bucket);
+
+  /* only the predecessors of the removed states have to be redirected */
+  for (s = bremoved->nxt; s != removed; s = s->nxt)
+    for (p = s->pred; p; p = p->nxt)
+      if (p->bstate->trans && retarget_btrans(p->bstate, 1))
+        touch_bstate(p->bstate);
 
   /*
    * As merging equivalent states can change the 'final' attribute of
@@ -296,100 +440,373 @@ int simplify_bstates() /* eliminates redundant states */
             "\nSimplification of the Buchi automaton - states: %ld.%06lis",
             t_diff.tv_sec, t_diff.tv_usec);
     fprintf(tl_out, "\n%i states removed\n", changed);
+    fprintf(tl_out, "round %i: %i states revisited, %i pairs compared\n",
+            ++bround, bvisit, bcompare);
   }
+  bvisit = bcompare = 0;
 
   return changed;
 }
 
-int bdfs(BState *s) {
-  BTrans *t;
-  BScc *c;
-  BScc *scc = (BScc *)tl_emalloc(sizeof(BScc));
-  scc->bstate = s;
-  scc->rank = rank;
-  scc->theta = rank++;
-  scc->nxt = scc_stack;
-  scc_stack = scc;
-
-  s->incoming = 1;
+void bpush(BState *s) /* starts the exploration of a state */
+{
+  BScc *c = &bdfs_stack[bdfs_depth++];
+  c->bstate = s;
+  c->trans = s->trans->nxt;
+  c->rank = rank;
+  c->theta = rank++;
+  s->incoming = -c->rank - 1; /* on the stack, -1 means a trivial scc */
+  scc_stack[scc_top++] = s;
+}
 
-  for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-    if (t->to->incoming == 0) {
-      int result = bdfs(t->to);
-      scc->theta = min(scc->theta, result);
-    } else {
-      for (c = scc_stack->nxt; c != 0; c = c->nxt)
-        if (c->bstate == t->to) {
-          scc->theta = min(scc->theta, c->rank);
-          break;
-        }
+void bdfs(BState *s) { /* marks the trivial SCCs reachable from s (Tarjan) */
+  BScc *c;
+  BTrans *t;
+  bpush(s);
+  while (bdfs_depth > 0) {
+    c = &bdfs_stack[bdfs_depth - 1];
+    if (c->trans != c->bstate->trans) {
+      t = c->trans;
+      c->trans = t->nxt;
+      if (t->to->incoming == 0)
+        bpush(t->to);
+      else if (t->to->incoming < -1) /* t->to is on the stack */
+        c->theta = min(c->theta, -t->to->incoming - 1);
+      continue;
     }
-  }
-  if (scc->rank == scc->theta) {
-    if (scc_stack == scc) { /* s is alone in a scc */
-      s->incoming = -1;
-      for (t = s->trans->nxt; t != s->trans; t = t->nxt)
-        if (t->to == s)
-          s->incoming = 1;
+    if (c->rank == c->theta) { /* c->bstate is the root of an scc */
+      s = c->bstate;
+      if (scc_stack[scc_top - 1] == s) { /* s is alone in a scc */
+        s->incoming = -1;
+        for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+          if (t->to == s)
+            s->incoming = 1;
+        scc_top--;
+      } else
+        do
+          scc_stack[--scc_top]->incoming = 1;
+        while (scc_stack[scc_top] != s);
     }
-    scc_stack = scc->nxt;
+    if (--bdfs_depth > 0)
+      bdfs_stack[bdfs_depth - 1].theta =
+          min(bdfs_stack[bdfs_depth - 1].theta, c->theta);
   }
-  return scc->theta;
 }
 
 void simplify_bscc() {
   BState *s;
+  int i, n, *old;
   rank = 1;
-  scc_stack = 0;
+  bpass++;
 
   if (bstates == bstates->nxt)
     return;
 
-  for (s = bstates->nxt; s != bstates; s = s->nxt)
+  for (n = 0, s = bstates->nxt; s != bstates; s = s->nxt)
+    n++;
+  old = (int *)tl_emalloc(n * sizeof(int)); /* to find the changed states */
+  for (i = 0, s = bstates->nxt; s != bstates; s = s->nxt, i++) {
+    old[i] = s->incoming;
     s->incoming = 0; /* state color = white */
+  }
 
+  bdfs_stack = (BScc *)tl_emalloc(n * sizeof(BScc));
+  scc_stack = (BState **)tl_emalloc(n * sizeof(BState *));
+  bdfs_depth = scc_top = 0;
   bdfs(bstates->prv);
+  tfree(bdfs_stack);
+  tfree(scc_stack);
 
-  for (s = bstates->nxt; s != bstates; s = s->nxt)
+  for (i = 0, s = bstates->nxt; s != bstates; s = s->nxt, i++)
     if (s->incoming == 0)
-      remove_bstate(s, 0);
+      s = remove_bstate(s, 0);
+    else if ((old[i] < 0) != (s->incoming < 0)) /* trivial or not */
+      touch_bstate(s);
+  tfree(old);
+}
+
+typedef struct BSim { /* a transition in the signature of a state */
+  unsigned long hash;
+  int cls; /* class of the target */
+  BTrans *t;
+} BSim;
+
+static int cmp_bsim(const void *x, const void *y) {
+  const BSim *a = (const BSim *)x, *b = (const BSim *)y;
+  if (a->hash != b->hash)
+    return (a->hash > b->hash) - (a->hash < b->hash);
+  return a->cls - b->cls;
+}
+
+/* class c is simulated by class d */
+#define simulated(le, w, c, d) (((le)[(c) * (w) + (d) / 64] >> ((d) % 64)) & 1)
+
+int included_bsim(BSim *a, int na, BSim *b, int nb, uint64_t *le,
+                  int w) { /* each transition of a is matched by one of b */
+  int i, j;
+  for (i = 0; i < na; i++) {
+    for (j = 0; j < nb; j++)
+      if (simulated(le, w, a[i].cls, b[j].cls) &&
+          included_label(b[j].t->label, a[i].t->label))
+        break;
+    if (j == nb)
+      return 0;
+  }
+  return 1;
+}
+
+int same_bsim(BSim *a, int na, BSim *b, int nb) { /* same signatures */
+  int i;
+  if (na != nb)
+    return 0;
+  for (i = 0; i < na; i++)
+    if (a[i].hash != b[i].hash || a[i].cls != b[i].cls ||
+        a[i].t->label != b[i].t->label)
+      return 0;
+  return 1;
+}
+
+int simplify_bsim() /* merges the states simulating each other, and removes
+                       the transitions whose target is simulated by the
+                       target of another transition of the state */
+{
+  BState *s, **order, *removed = bremoved->nxt;
+  BTrans *t, *t1;
+  BPred *p;
+  BSim *sig;
+  int i, j, k, a, b, n, m, w, nw, size, classes = 1, pairs = 1, new_classes,
+      new_pairs, states = 0, trans = 0;
+  int *cls, *new_cls, *tmp, *start, *len, *rep, *parent, *bucket, *next, *keep;
+  uint64_t *le, *new_le;
+  unsigned long *save, h;
+
+  if (tl_stats)
+    getrusage(RUSAGE_SELF, &tr_debut);
+
+  for (n = 0, m = 0, s = bstates->nxt; s != bstates; s = s->nxt, n++)
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+      m++;
+  if (n == 0)
+    return 0;
+  bpass++;
+
+  /* s->sig holds the number of s during this pass */
+  order = (BState **)tl_emalloc(n * sizeof(BState *));
+  save = (unsigned long *)tl_emalloc(n * sizeof(unsigned long));
+  for (i = 0, s = bstates->nxt; s != bstates; s = s->nxt, i++) {
+    order[i] = s;
+    save[i] = s->sig;
+    s->sig = i;
+  }
+  sig = (BSim *)tl_emalloc((m + 1) * sizeof(BSim));
+  start = (int *)tl_emalloc(n * sizeof(int));
+  len = (int *)tl_emalloc(n * sizeof(int));
+  for (i = 0, k = 0; i < n; i++) {
+    start[i] = k;
+    for (t = order[i]->trans->nxt; t != order[i]->trans; t = t->nxt, k++) {
+      sig[k].t = t;
+      sig[k].hash = label_hash(t->label);
+    }
+    len[i] = k - start[i];
+  }
+  for (size = 1; size < n; size *= 2)
+    ;
+  cls = (int *)tl_emalloc(n * sizeof(int));
+  new_cls = (int *)tl_emalloc(n * sizeof(int));
+  rep = (int *)tl_emalloc(n * sizeof(int));
+  parent = (int *)tl_emalloc(n * sizeof(int));
+  next = (int *)tl_emalloc(n * sizeof(int));
+  bucket = (int *)tl_emalloc(size * sizeof(int));
+  w = 1;
+  le = (uint64_t *)tl_emalloc(sizeof(uint64_t));
+  le[0] = 1; /* a single class, simulated by itself */
+
+  /* refines the classes by the signatures of their states (acceptance,
+     and labels and target classes of the transitions) until the simulation
+     between the classes is stable */
+  while (1) {
+    for (i = 0; i < n; i++) {
+      for (k = 0; k < len[i]; k++)
+        sig[start[i] + k].cls = cls[sig[start[i] + k].t->to->sig];
+      qsort(sig + start[i], len[i], sizeof(BSim), cmp_bsim);
+    }
+
+    memset(bucket, 0, size * sizeof(int));
+    for (new_classes = 0, i = 0; i < n; i++) {
+      h = cls[i] * 2 + (order[i]->final == accept);
+      for (k = start[i]; k < start[i] + len[i]; k++)
+        h = (h ^ (sig[k].hash * 31 + sig[k].cls)) * 1099511628211UL;
+      for (j = bucket[h & (size - 1)]; j; j = next[j - 1]) {
+        k = rep[j - 1];
+        if (cls[k] == cls[i] && order[k]->final == order[i]->final &&
+            same_bsim(sig + start[k], len[k], sig + start[i], len[i]))
+          break;
+      }
+      if (!j) { /* a new class */
+        rep[new_classes] = i;
+        parent[new_classes] = cls[i];
+        next[new_classes] = bucket[h & (size - 1)];
+        bucket[h & (size - 1)] = j = ++new_classes;
+      }
+      new_cls[i] = j - 1;
+    }
+
+    nw = (new_classes + 63) / 64;
+    new_le = (uint64_t *)tl_emalloc(new_classes * nw * sizeof(uint64_t));
+    for (new_pairs = 0, i = 0; i < new_classes; i++)
+      for (j = 0; j < new_classes; j++) {
+        a = rep[i];
+        b = rep[j];
+        if (simulated(le, w, parent[i], parent[j]) &&
+            (order[a]->final != accept || order[b]->final == accept) &&
+            included_bsim(sig + start[a], len[a], sig + start[b], len[b], le,
+                          w)) {
+          new_le[i * nw + j / 64] |= (uint64_t)1 << (j % 64);
+          new_pairs++;
+        }
+      }
+    tfree(le);
+    le = new_le;
+    w = nw;
+    tmp = cls;
+    cls = new_cls;
+    new_cls = tmp;
+    if (new_classes == classes && new_pairs == pairs)
+      break;
+    classes = new_classes;
+    pairs = new_pairs;
+  }
+
+  /* t is useless if another transition t1 has a weaker label, and a target
+     simulating the one of t */
+  for (i = 0; i < n; i++) {
+    s = order[i];
+    for (t = s->trans->nxt; t != s->trans;) {
+      for (t1 = s->trans->nxt; t1 != s->trans; t1 = t1->nxt)
+        if (t1 != t &&
+            simulated(le, w, cls[t->to->sig], cls[t1->to->sig]) &&
+            included_label(t1->label, t->label))
+          break;
+      if (t1 != s->trans) {
+        BTrans *free = t->nxt;
+        copy_btrans(free, t);
+        t->nxt = free->nxt;
+        if (free == s->trans)
+          s->trans = t;
+        free_btrans(free, 0, 0);
+        touch_bstate(s);
+        trans++;
+      } else
+        t = t->nxt;
+    }
+  }
+
+  /* the states of classes simulating each other are merged into the last
+     one in the list, so that the initial state is kept */
+  for (i = 0; i < classes; i++)
+    for (j = 0; j <= i; j++)
+      if (simulated(le, w, i, j) && simulated(le, w, j, i)) {
+        parent[i] = j;
+        break;
+      }
+  keep = (int *)tl_emalloc(classes * sizeof(int));
+  for (i = n - 1; i >= 0; i--)
+    if (!keep[parent[cls[i]]])
+      keep[parent[cls[i]]] = i + 1;
+  for (i = 0; i < n; i++)
+    if ((k = keep[parent[cls[i]]] - 1) != i) {
+      touch_bstate(order[k]);
+      remove_bstate(order[i], order[k]);
+      states++;
+    }
+
+  for (i = 0; i < n; i++)
+    order[i]->sig = save[i];
+  tfree(order);
+  tfree(save);
+  tfree(sig);
+  tfree(start);
+  tfree(len);
+  tfree(cls);
+  tfree(new_cls);
+  tfree(rep);
+  tfree(parent);
+  tfree(next);
+  tfree(bucket);
+  tfree(keep);
+  tfree(le);
+
+  /* only the predecessors of the removed states have to be redirected */
+  for (s = bremoved->nxt; s != removed; s = s->nxt)
+    for (p = s->pred; p; p = p->nxt)
+      if (p->bstate->trans && retarget_btrans(p->bstate, 1))
+        touch_bstate(p->bstate);
+
+  if (tl_stats) {
+    getrusage(RUSAGE_SELF, &tr_fin);
+    timeval_subtract(&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
+    fprintf(tl_out,
+            "\nSimplification of the Buchi automaton - simulation: %ld.%06lis",
+            t_diff.tv_sec, t_diff.tv_usec);
+    fprintf(tl_out, "\n%i classes, %i states removed, %i transitions removed\n",
+            classes, states, trans);
+  }
+  return states + trans;
 }
 
 /********************************************************************\
 |*              Generation of the Buchi automaton                   *|
 \********************************************************************/
 
+unsigned hash_bstate(GState *gstate, int final) {
+  return (unsigned)gstate->id * (accept + 1) + final;
+}
+
+void index_bstate(BState *s) { /* adds a state to the index of find_bstate */
+  BState **old = bindex, *s1;
+  int i, old_size = bindex_size;
+  unsigned h;
+
+  if (bindex_count >= bindex_size) { /* doubles the number of buckets */
+    bindex_size *= 2;
+    bindex = (BState **)tl_emalloc(bindex_size * sizeof(BState *));
+    for (i = 0; i < old_size; i++)
+      while ((s1 = old[i])) {
+        old[i] = s1->hnxt;
+        h = hash_bstate(s1->gstate, s1->final) & (bindex_size - 1);
+        s1->hnxt = bindex[h];
+        bindex[h] = s1;
+      }
+    tfree(old);
+  }
+  h = hash_bstate(s->gstate, s->final) & (bindex_size - 1);
+  s->hnxt = bindex[h];
+  bindex[h] = s;
+  bindex_count++;
+}
+
+void unindex_bstate(BState *s) { /* removes a state from the index */
+  BState **p =
+      &bindex[hash_bstate(s->gstate, s->final) & (bindex_size - 1)];
+  while (*p != s)
+    p = &(*p)->hnxt;
+  *p = s->hnxt;
+  bindex_count--;
+}
+
 BState *
 find_bstate(GState **state, int final,
             BState *s) { /* finds the corresponding state, or creates it */
   if ((s->gstate == *state) && (s->final == final))
     return s; /* same state */
 
-  s = bstack->nxt; /* in the stack */
-  bstack->gstate = *state;
-  bstack->final = final;
-  while (!(s->gstate == *state) || !(s->final == final))
-    s = s->nxt;
-  if (s != bstack)
-    return s;
-
-  s = bstates->nxt; /* in the solved states */
-  bstates->gstate = *state;
-  bstates->final = final;
-  while (!(s->gstate == *state) || !(s->final == final))
-    s = s->nxt;
-  if (s != bstates)
-    return s;
-
-  s = bremoved->nxt; /* in the removed states */
-  bremoved->gstate = *state;
-  bremoved->final = final;
-  while (!(s->gstate == *state) || !(s->final == final))
-    s = s->nxt;
-  if (s != bremoved)
-    return s;
-
-  s = (BState *)tl_emalloc(sizeof(BState)); /* creates a new state */
+  /* the states of the stack, the solved and the removed states */
+  for (s = bindex[hash_bstate(*state, final) & (bindex_size - 1)]; s;
+       s = s->hnxt)
+    if ((s->gstate == *state) && (s->final == final))
+      return s;
+
+  s = (BState *)slab_alloc(sizeof(BState)); /* creates a new state */
   s->gstate = *state;
   s->id = (*state)->id;
   s->incoming = 0;
@@ -398,69 +815,116 @@ find_bstate(GState **state, int final,
   s->trans->nxt = s->trans;
   s->nxt = bstack->nxt;
   bstack->nxt = s;
+  index_bstate(s);
   return s;
 }
 
-int next_final(int *set, int fin) /* computes the 'final' value */
+int next_final(GTrans *t, int fin) /* computes the 'final' value */
 {
-  if ((fin != accept) && in_set(set, final[fin + 1]))
-    return next_final(set, fin + 1);
+  uint64_t m;
+  if (fin == accept)
+    return fin;
+  if (final_mask) { /* the conditions fin+1, fin+2... met in a row */
+    m = ~(t->accept >> fin);
+    return m ? fin + __builtin_ctzll(m) : accept;
+  }
+  if (in_set(t->final, final[fin + 1]))
+    return next_final(t, fin + 1);
   return fin;
 }
 
+int scc_next_final(GState *s, GTrans *t,
+                   int fin) /* computes the 'final' value of t from s */
+{
+  /* only the counter of an accepting scc matters: it is reset elsewhere,
+     which saves the copies of the other states */
+  if (tl_degen_scc && bad_scc &&
+      (t->to->incoming != s->incoming || in_set(bad_scc, s->incoming)))
+    return 0;
+  return next_final(t, fin);
+}
+
+int btrans_key(int *key, BState *to, uint64_t *pos,
+               uint64_t *neg) /* lists the label of a transition for the index:
+                            the target state, then the literals */
+{
+  int n = 0, offset = (gstate_id + 1) * (accept + 1);
+  key[n++] = to->gstate->id * (accept + 1) + to->final;
+  n += fill_list(pos, 1, key + n, offset);
+  offset += sym_size * 8 * sizeof(uint64_t);
+  n += fill_list(neg, 1, key + n, offset);
+  return n;
+}
+
+int add_btrans(BState *s, BState *to, GTrans *t,
+               STrie *index) /* adds a transition unless it is redondant,
+                                returns the change in the number of
+                                transitions */
+{
+  int n = 0, changed = 0;
+  BTrans *trans;
+  if (tl_simp_fly) {
+    STrie *f, *nf;
+    n = btrans_key(bkey, to, t->pos, t->neg);
+    for (f = strie_supersets(index, bkey, n); f; f = nf) {
+      BTrans *t1 = (BTrans *)f->item; /* t1 is redondant */
+      nf = f->found;
+      t1->to->incoming--;
+      t1->to = (BState *)0; /* removed by sweep_btrans */
+      strie_remove(f);
+      changed--;
+    }
+    if (strie_subset(index, bkey, n)) /* t is redondant */
+      return changed;
+  }
+  trans = emalloc_btrans();
+  trans->to = to;
+  trans->to->incoming++;
+  trans->pos = t->pos;
+  trans->neg = t->neg;
+  trans->label = t->label;
+  trans->nxt = s->trans->nxt;
+  s->trans->nxt = trans;
+  if (tl_simp_fly)
+    strie_insert(index, bkey, n, trans);
+  return changed + 1;
+}
+
+void sweep_btrans(BState *s) /* removes the transitions marked by add_btrans */
+{
+  BTrans *t;
+  for (t = s->trans; t->nxt != s->trans;)
+    if (!t->nxt->to) {
+      BTrans *free = t->nxt;
+      t->nxt = free->nxt;
+      free_btrans(free, 0, 0);
+    } else
+      t = t->nxt;
+}
+
 void make_btrans(BState *s) /* creates all the transitions from a state */
 {
   int state_trans = 0;
   GTrans *t;
-  BTrans *t1;
   BState *s1;
+  STrie *index = tl_simp_fly ? new_strie() : (STrie *)0;
   if (s->gstate->trans)
     for (t = s->gstate->trans->nxt; t != s->gstate->trans; t = t->nxt) {
-      int fin = next_final(t->final, (s->final == accept) ? 0 : s->final);
+      int fin =
+          scc_next_final(s->gstate, t, (s->final == accept) ? 0 : s->final);
       BState *to = find_bstate(&t->to, fin, s);
-
-      for (t1 = s->trans->nxt; t1 != s->trans;) {
-        if (tl_simp_fly && (to == t1->to) && included_set(t->pos, t1->pos, 1) &&
-            included_set(t->neg, t1->neg, 1)) { /* t1 is redondant */
-          BTrans *free = t1->nxt;
-          t1->to->incoming--;
-          t1->to = free->to;
-          copy_set(free->pos, t1->pos, 1);
-          copy_set(free->neg, t1->neg, 1);
-          t1->nxt = free->nxt;
-          if (free == s->trans)
-            s->trans = t1;
-          free_btrans(free, 0, 0);
-          state_trans--;
-        } else if (tl_simp_fly && (t1->to == to) &&
-                   included_set(t1->pos, t->pos, 1) &&
-                   included_set(t1->neg, t->neg, 1)) /* t is redondant */
-          break;
-        else
-          t1 = t1->nxt;
-      }
-      if (t1 == s->trans) {
-        BTrans *trans = emalloc_btrans();
-        trans->to = to;
-        trans->to->incoming++;
-        copy_set(t->pos, trans->pos, 1);
-        copy_set(t->neg, trans->neg, 1);
-        trans->nxt = s->trans->nxt;
-        s->trans->nxt = trans;
-        state_trans++;
-      }
+      state_trans += add_btrans(s, to, t, index);
     }
 
   if (tl_simp_fly) {
+    free_strie(index);
+    sweep_btrans(s);
     if (s->trans == s->trans->nxt) { /* s has no transitions */
       free_btrans(s->trans->nxt, s->trans, 1);
       s->trans = (BTrans *)0;
       s->prv = (BState *)0;
       s->nxt = bremoved->nxt;
       bremoved->nxt = s;
-      for (s1 = bremoved->nxt; s1 != bremoved; s1 = s1->nxt)
-        if (s1->prv == s)
-          s1->prv = (BState *)0;
       return;
     }
     bstates->trans = s->trans;
@@ -474,9 +938,6 @@ void make_btrans(BState *s) /* creates all the transitions from a state */
       s->prv = s1;
       s->nxt = bremoved->nxt;
       bremoved->nxt = s;
-      for (s1 = bremoved->nxt; s1 != bremoved; s1 = s1->nxt)
-        if (s1->prv == s)
-          s1->prv = s->prv;
       return;
     }
   }
@@ -491,30 +952,123 @@ void make_btrans(BState *s) /* creates all the transitions from a state */
 /********************************************************************\
 |*                  Display of the Buchi automaton                  *|
 \********************************************************************/
+
+typedef struct BGroup { /* the transitions of a state to the same state */
+  BState *to;
+  BTrans **trans;
+  int count;
+  int slot; /* see make_bview */
+} BGroup;
+
+typedef struct BView { /* a state, with its transitions grouped */
+  BState *bstate;
+  BGroup *group;
+  int count;
+} BView;
+
+static BView *bview; /* the states, in the order they are displayed */
+static BGroup *bgroup;
+static BTrans **bview_trans;
+static int bview_count, *bslot, bslot_size;
+
+int *find_bslot(BGroup *group, BState *to) { /* the slot of the group of the
+                                                transitions to 'to' */
+  int h = ((unsigned)to->id * 31 + to->final) & (bslot_size - 1);
+  while (bslot[h] && (group[bslot[h] - 1].to->id != to->id ||
+                      group[bslot[h] - 1].to->final != to->final))
+    h = (h + 1) & (bslot_size - 1);
+  return &bslot[h];
+}
+
+void make_bview() { /* groups the transitions of each state by target, in
+                       the order of their first transition */
+  BState *s;
+  BTrans *t;
+  BView *v;
+  BGroup *g;
+  int i, j, k, m = 0, degree, max_degree = 0, *slot;
+
+  for (bview_count = 0, s = bstates->nxt; s != bstates; s = s->nxt) {
+    for (degree = 0, t = s->trans->nxt; t != s->trans; t = t->nxt)
+      degree++;
+    m += degree;
+    if (degree > max_degree)
+      max_degree = degree;
+    bview_count++;
+  }
+  for (bslot_size = 1; bslot_size < 2 * max_degree; bslot_size *= 2)
+    ;
+  bslot = (int *)tl_emalloc(bslot_size * sizeof(int));
+  bview = (BView *)tl_emalloc((bview_count + 1) * sizeof(BView));
+  bgroup = (BGroup *)tl_emalloc((m + 1) * sizeof(BGroup));
+  bview_trans = (BTrans **)tl_emalloc((m + 1) * sizeof(BTrans *));
+
+  for (i = 0, j = 0, k = 0, s = bstates->prv; s != bstates; s = s->prv) {
+    v = &bview[i++];
+    v->bstate = s;
+    v->group = bgroup + j;
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      slot = find_bslot(v->group, t->to);
+      if (!*slot) { /* a new target */
+        *slot = ++v->count;
+        v->group[v->count - 1].to = t->to;
+        v->group[v->count - 1].slot = slot - bslot;
+      }
+      v->group[*slot - 1].count++;
+    }
+    for (g = v->group; g < v->group + v->count; g++) {
+      g->trans = bview_trans + k;
+      k += g->count;
+      g->count = 0;
+    }
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      g = &v->group[*find_bslot(v->group, t->to) - 1];
+      g->trans[g->count++] = t;
+    }
+    for (g = v->group; g < v->group + v->count; g++)
+      bslot[g->slot] = 0;
+    j += v->count;
+  }
+}
+
+void free_bview() {
+  tfree(bslot);
+  tfree(bview);
+  tfree(bgroup);
+  tfree(bview_trans);
+  bview = (BView *)0;
+  bview_count = 0;
+}
+
 void dump_buchi_to_json() {
   BTrans *t;
   BState *s;
+  BGroup *g;
+  int i, j;
   cJSON *root = cJSON_CreateObject();
   cJSON *states = cJSON_CreateArray();
   cJSON *transitions = cJSON_CreateArray();
 
-  for (s = bstates->prv; s != bstates; s = s->prv) {
+  for (i = 0; i < bview_count; i++) {
+    s = bview[i].bstate;
     cJSON *state = cJSON_CreateObject();
     cJSON_AddNumberToObject(state, "id", s->id);
     cJSON_AddNumberToObject(state, "final", s->final);
     cJSON_AddItemToArray(states, state);
 
-    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-      cJSON *transition = cJSON_CreateObject();
-      cJSON_AddNumberToObject(transition, "from", s->id);
-      cJSON_AddNumberToObject(transition, "to", t->to->id);
+    for (g = bview[i].group; g < bview[i].group + bview[i].count; g++)
+      for (j = 0; j < g->count; j++) {
+        t = g->trans[j];
+        cJSON *transition = cJSON_CreateObject();
+        cJSON_AddNumberToObject(transition, "from", s->id);
+        cJSON_AddNumberToObject(transition, "to", t->to->id);
 
-      // Convert the conditions to a JSON array and add it to the transition
-      cJSON *conditions = conditions_to_json_array(t->pos, t->neg);
-      cJSON_AddItemToObject(transition, "conditions", conditions);
+        // Convert the conditions to a JSON array and add it to the transition
+        cJSON *conditions = conditions_to_json_array(t->pos, t->neg);
+        cJSON_AddItemToObject(transition, "conditions", conditions);
 
-      cJSON_AddItemToArray(transitions, transition);
-    }
+        cJSON_AddItemToArray(transitions, transition);
+      }
   }
 
   cJSON_AddItemToObject(root, "states", states);
@@ -531,10 +1085,15 @@ void dump_buchi_to_json() {
   free(json_output);
 }
 void dump_buchi_dot() {
-  BState *s;           // pointer to a state
-  BTrans *t;           // pointer to a transition
-  char condition[256]; // buffer to store the condition string
-  int accept_all = 0;  // flag to check if all states are accepting
+  BState *s;          // pointer to a state
+  BGroup *g;          // transitions of a state to the same state
+  char *condition;    // buffer to store the condition string
+  int i, j, size = 16;
+
+  // The longest condition names every predicate once
+  for (i = 0; i < sym_id; i++)
+    size += strlen(sym_table[i]) + 4;
+  condition = (char *)tl_emalloc(size);
 
   // Open the dot file for writing
   FILE *dot_out = fopen("buchi.dot", "w");
@@ -543,29 +1102,22 @@ void dump_buchi_dot() {
   fprintf(dot_out, "digraph Buchi {\n");
 
   // Iterate over all states in reverse order
-  for (s = bstates->prv; s != bstates; s = s->prv) {
+  for (i = 0; i < bview_count; i++) {
     char state_name[256];      // buffer to store the state name
     char dest_state_name[256]; // buffer to store the destination state name
-    if (s->id == 0) {          /* accept_all at the end */
-      accept_all = 1;
+    s = bview[i].bstate;
+    if (s->id == 0) /* accept_all at the end */
       continue;
-    }
-    // Iterate over all transitions of the current state
-    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-      get_state_name(state_name, s);
-      get_state_name(dest_state_name, t->to);
-      // Generate the condition string based on the positive and negative
-      // sets of the transition
-      spin_sprint_set(condition, t->pos, t->neg);
-
-      // Print the transition from the current state to the final state of the
-      // transition with the condition as the label
-      fprintf(dot_out, "\t%s -> %s [label=\"%s\"];\n", state_name,
-              dest_state_name, condition);
-
-      // Clean the char buffer;
-      memset(state_name, 0, strlen(state_name));
-      memset(dest_state_name, 0, strlen(dest_state_name));
+    get_state_name(state_name, s);
+    // One edge per destination, labelled by the disjunction of the conditions
+    for (g = bview[i].group; g < bview[i].group + bview[i].count; g++) {
+      get_state_name(dest_state_name, g->to);
+      fprintf(dot_out, "\t%s -> %s [label=\"", state_name, dest_state_name);
+      for (j = 0; j < g->count; j++) {
+        spin_sprint_set(condition, g->trans[j]->pos, g->trans[j]->neg);
+        fprintf(dot_out, "%s%s", j ? " || " : "", condition);
+      }
+      fprintf(dot_out, "\"];\n");
     }
   }
 
@@ -574,6 +1126,7 @@ void dump_buchi_dot() {
 
   // Close the dot file
   fclose(dot_out);
+  tfree(condition);
 }
 
 void get_state_name(char *buffer, BState *s) {
@@ -630,8 +1183,9 @@ void print_buchi(BState *s) /* dumps the Buchi automaton */
 }
 
 void print_spin_buchi() {
-  BTrans *t;          // pointer to a transition
   BState *s;          // pointer to a state
+  BGroup *g;          // transitions of a state to the same state
+  int i, j;
   int accept_all = 0; // flag to check if all states are accepting
   // Check if the automaton is empty
   if (bstates->nxt == bstates) { /* empty automaton */
@@ -661,7 +1215,8 @@ void print_spin_buchi() {
   put_uform();
   fprintf(tl_out, " */\n");
   // Iterate over all states in reverse order
-  for (s = bstates->prv; s != bstates; s = s->prv) {
+  for (i = 0; i < bview_count; i++) {
+    s = bview[i].bstate;
     // If the state is an accepting state, set accept_all to 1 and continue
     if (s->id == 0) { /* accept_all at the end */
       accept_all = 1;
@@ -683,41 +1238,30 @@ void print_spin_buchi() {
       continue;
     }
 
-    // Print the transitions of the state
+    // Print the transitions of the state, one line per destination
     fprintf(tl_out, "\tif\n");
-    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-      BTrans *t1;
-      // Start of a transition condition
+    for (g = bview[i].group; g < bview[i].group + bview[i].count; g++) {
+      // The disjunction of the conditions of the transitions
       fprintf(tl_out, "\t:: (");
-      // print the positive and negative sets of the transition
-      spin_print_set(t->pos, t->neg);
-      // Iterate over all transitions until the current transition
-      for (t1 = t; t1->nxt != s->trans;)
-        // If the next transition leads to the same state as the current
-        // transition
-        if (t1->nxt->to->id == t->to->id &&
-            t1->nxt->to->final == t->to->final) {
-          // Start of another transition condition
+      for (j = 0; j < g->count; j++) {
+        if (j)
           fprintf(tl_out, ") || (");
-          // print the positive and negative sets
-          spin_print_set(t1->nxt->pos, t1->nxt->neg);
-          t1->nxt = t1->nxt->nxt;
-        } else
-          t1 = t1->nxt;
+        spin_print_set(g->trans[j]->pos, g->trans[j]->neg);
+      }
       // End of a transition condition and start of the transition action
       fprintf(tl_out, ") -> goto ");
       // Print the final state of the transition
-      if (t->to->final == accept)
+      if (g->to->final == accept)
         fprintf(tl_out, "accept_");
       else
-        fprintf(tl_out, "T%i_", t->to->final);
+        fprintf(tl_out, "T%i_", g->to->final);
       // Print the id of the final state
-      if (t->to->id == 0)
+      if (g->to->id == 0)
         fprintf(tl_out, "all\n");
-      else if (t->to->id == -1)
+      else if (g->to->id == -1)
         fprintf(tl_out, "init\n");
       else
-        fprintf(tl_out, "S%i\n", t->to->id);
+        fprintf(tl_out, "S%i\n", g->to->id);
     }
     // End of the if construct for transitions
     fprintf(tl_out, "\tfi;\n");
@@ -738,19 +1282,21 @@ void print_spin_buchi() {
 void mk_buchi() { /* generates a Buchi automaton from the generalized Buchi
                      automaton */
   int i;
-  BState *s = (BState *)tl_emalloc(sizeof(BState));
+  BState *s = (BState *)slab_alloc(sizeof(BState));
   GTrans *t;
-  BTrans *t1;
+  BTrans *bt;
+  STrie *index;
+  ArenaMark m;
   accept = final[0] - 1;
 
   if (tl_stats)
     getrusage(RUSAGE_SELF, &tr_debut);
 
-  bstack = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
+  bstack = (BState *)slab_alloc(sizeof(BState)); /* sentinel */
   bstack->nxt = bstack;
-  bremoved = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
+  bremoved = (BState *)slab_alloc(sizeof(BState)); /* sentinel */
   bremoved->nxt = bremoved;
-  bstates = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
+  bstates = (BState *)slab_alloc(sizeof(BState)); /* sentinel */
   bstates->nxt = s;
   bstates->prv = s;
 
@@ -762,53 +1308,38 @@ void mk_buchi() { /* generates a Buchi automaton from the generalized Buchi
   s->gstate = 0;
   s->trans = emalloc_btrans(); /* sentinel */
   s->trans->nxt = s->trans;
+  bkey = (int *)tl_emalloc((1 + 2 * sym_size * 8 * sizeof(uint64_t)) * sizeof(int));
+  bindex_size = 256;
+  bindex = (BState **)tl_emalloc(bindex_size * sizeof(BState *));
+  index = tl_simp_fly ? new_strie() : (STrie *)0;
   for (i = 0; i < init_size; i++)
     if (init[i])
       for (t = init[i]->trans->nxt; t != init[i]->trans; t = t->nxt) {
-        int fin = next_final(t->final, 0);
+        int fin = scc_next_final(init[i], t, 0);
         BState *to = find_bstate(&t->to, fin, s);
-        for (t1 = s->trans->nxt; t1 != s->trans;) {
-          if (tl_simp_fly && (to == t1->to) &&
-              included_set(t->pos, t1->pos, 1) &&
-              included_set(t->neg, t1->neg, 1)) { /* t1 is redondant */
-            BTrans *free = t1->nxt;
-            t1->to->incoming--;
-            t1->to = free->to;
-            copy_set(free->pos, t1->pos, 1);
-            copy_set(free->neg, t1->neg, 1);
-            t1->nxt = free->nxt;
-            if (free == s->trans)
-              s->trans = t1;
-            free_btrans(free, 0, 0);
-          } else if (tl_simp_fly && (t1->to == to) &&
-                     included_set(t1->pos, t->pos, 1) &&
-                     included_set(t1->neg, t->neg, 1)) /* t is redondant */
-            break;
-          else
-            t1 = t1->nxt;
-        }
-        if (t1 == s->trans) {
-          BTrans *trans = emalloc_btrans();
-          trans->to = to;
-          trans->to->incoming++;
-          copy_set(t->pos, trans->pos, 1);
-          copy_set(t->neg, trans->neg, 1);
-          trans->nxt = s->trans->nxt;
-          s->trans->nxt = trans;
-        }
+        add_btrans(s, to, t, index);
       }
+  if (tl_simp_fly) {
+    free_strie(index);
+    sweep_btrans(s);
+  }
 
   while (bstack->nxt !=
          bstack) { /* solves all states in the stack until it is empty */
     s = bstack->nxt;
     bstack->nxt = bstack->nxt->nxt;
     if (!s->incoming) {
+      unindex_bstate(s);
       free_bstate(s);
       continue;
     }
     make_btrans(s);
   }
 
+  tfree(bkey);
+  tfree(bindex);
+  bindex = (BState **)0;
+  bindex_size = bindex_count = 0;
   retarget_all_btrans();
 
   if (tl_stats) {
@@ -828,14 +1359,34 @@ void mk_buchi() { /* generates a Buchi automaton from the generalized Buchi
   }
 
   if (tl_simp_diff) {
-    simplify_btrans();
-    if (tl_simp_scc)
-      simplify_bscc();
-    while (simplify_bstates()) { /* simplifies as much as possible */
+    for (s = bstates->nxt; s != bstates; s = s->nxt) {
+      touch_bstate(s); /* every state is to be simplified */
+      for (bt = s->trans->nxt; bt != s->trans; bt = bt->nxt)
+        add_bpred(bt->to, s);
+    }
+    do {
       simplify_btrans();
       if (tl_simp_scc)
         simplify_bscc();
+      while (simplify_bstates()) { /* simplifies as much as possible */
+        simplify_btrans();
+        if (tl_simp_scc)
+          simplify_bscc();
+      }
+    } while (tl_simp_sim && simplify_bsim());
+    if (bsig_buf) {
+      tfree(bsig_buf);
+      bsig_buf = (unsigned long *)0;
+      bsig_size = 0;
+    }
+    if (bwork) {
+      tfree(bwork);
+      bwork = (BState **)0;
+      bwork_size = bwork_count = 0;
     }
+    for (s = bstates->nxt; s != bstates; s = s->nxt)
+      free_bpred(s);
+    free_bremoved();
 
     if (tl_verbose) {
       fprintf(tl_out, "\nBuchi automaton after simplification\n");
@@ -845,8 +1396,12 @@ void mk_buchi() { /* generates a Buchi automaton from the generalized Buchi
       fprintf(tl_out, "\n");
     }
   }
+  m = arena_mark(); /* the view only lives while the writers run */
+  make_bview();     /* shared by the writers below */
   dump_buchi_to_json();
   dump_buchi_dot();
 
   print_spin_buchi();
+  free_bview();
+  arena_release(m);
 }
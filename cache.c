@@ -87,7 +87,7 @@ Node *cached(Node *n) {
     return m;
 
   Caches++;
-  d = (Cache *)tl_emalloc(sizeof(Cache));
+  d = (Cache *)slab_alloc(sizeof(Cache));
   d->before = dupnode(n);
   d->after = Canonical(n); /* n is released */
 
@@ -116,11 +116,11 @@ void releasenode(int all_levels, Node *n) {
     releasenode(1, n->rgt);
     n->rgt = ZN;
   }
-  tfree((void *)n);
+  slab_free(n, sizeof(Node));
 }
 
 Node *tl_nn(int t, Node *ll, Node *rl) {
-  Node *n = (Node *)tl_emalloc(sizeof(Node));
+  Node *n = (Node *)slab_alloc(sizeof(Node));
 
   n->ntyp = (short)t;
   n->lft = ll;
@@ -135,7 +135,7 @@ Node *getnode(Node *p) {
   if (!p)
     return p;
 
-  n = (Node *)tl_emalloc(sizeof(Node));
+  n = (Node *)slab_alloc(sizeof(Node));
   n->ntyp = p->ntyp;
   n->sym = p->sym; /* same name */
   n->lft = p->lft;
@@ -28,6 +28,7 @@
 /* http://www.lsv.ens-cachan.fr/~gastin                                   */
 
 #include "ltl2ba.h"
+#include <pthread.h>
 
 /********************************************************************\
 |*              Structures and shared variables                     *|
@@ -38,14 +39,26 @@ extern ATrans **transition;
 extern struct rusage tr_debut, tr_fin;
 extern struct timeval t_diff;
 extern int tl_verbose, tl_stats, tl_simp_diff, tl_simp_fly, tl_fjtofj,
-    tl_simp_scc, *final_set, node_id;
+    tl_simp_scc, tl_threads, node_id, node_size, sym_size, sym_id;
+extern uint64_t *final_set;
 extern char **sym_table;
 
 GState *gstack, *gremoved, *gstates, **init;
-static GScc *scc_stack;
+static GScc *gdfs_stack;
+static GState **scc_stack;
+static int gdfs_depth, scc_top;
 int init_size = 0, gstate_id = 1, gstate_count = 0, gtrans_count = 0;
-int *fin, *final, scc_id, scc_size, *bad_scc;
+int *final, scc_id, scc_size;
+uint64_t *bad_scc;
+int final_mask;      /* acceptance conditions are stored in GTrans.accept */
+uint64_t all_finals; /* the mask of all acceptance conditions */
+static int sig_size;
+static unsigned long *sig_buf;
 static int rank;
+static GState **gwork; /* states changed since the last simplify_gtrans */
+static int gwork_count, gwork_size;
+static int gpass, gtrans_mark, gstates_mark, gscc_mark, ground, gvisit,
+    gcompare;
 
 void print_generalized();
 
@@ -56,8 +69,8 @@ void print_generalized();
 void free_gstate(GState *s) /* frees a state and its transitions */
 {
   free_gtrans(s->trans->nxt, s->trans, 1);
-  tfree(s->nodes_set);
-  tfree(s);
+  free_packed(s->nodes_set, 0);
+  slab_free(s, sizeof(GState));
 }
 
 GState *remove_gstate(GState *s, GState *s1) /* removes a state */
@@ -67,31 +80,126 @@ GState *remove_gstate(GState *s, GState *s1) /* removes a state */
   s->nxt->prv = s->prv;
   free_gtrans(s->trans->nxt, s->trans, 0);
   s->trans = (GTrans *)0;
-  tfree(s->nodes_set);
+  free_packed(s->nodes_set, 0);
   s->nodes_set = 0;
   s->nxt = gremoved->nxt;
   gremoved->nxt = s;
-  s->prv = s1;
-  for (s1 = gremoved->nxt; s1 != gremoved; s1 = s1->nxt)
-    if (s1->prv == s)
-      s1->prv = s->prv;
+  s->prv = s1; /* s now redirects to s1, see redirect_gstate */
   return prv;
 }
 
+GState *redirect_gstate(GState *s) /* finds the state replacing s, following
+                                      the removed states (union-find) */
+{
+  GState *root = s, *nxt;
+  while (root && !root->trans) /* root has been removed */
+    root = root->prv;
+  while (s != root) { /* path compression */
+    nxt = s->prv;
+    s->prv = root;
+    s = nxt;
+  }
+  return root;
+}
+
+uint64_t set_to_mask(uint64_t *set) /* the acceptance conditions of a set of
+                                   nodes, by index */
+{
+  int i;
+  uint64_t m = 0;
+  for (i = 1; i < final[0]; i++)
+    if (in_set(set, final[i]))
+      m |= (uint64_t)1 << (i - 1);
+  return m;
+}
+
+int same_final(GTrans *s, GTrans *t) {
+  if (final_mask)
+    return s->accept == t->accept;
+  return same_sets(s->final, t->final, 0);
+}
+
+int included_final(GTrans *s,
+                   GTrans *t) { /* the conditions of s are also in t */
+  if (final_mask)
+    return !(s->accept & ~t->accept);
+  return included_set(s->final, t->final, 0);
+}
+
+void copy_final(GTrans *from, GTrans *to) {
+  if (final_mask)
+    to->accept = from->accept;
+  else
+    copy_set(from->final, to->final, 0);
+}
+
+void print_final(GTrans *t) {
+  int i;
+  uint64_t *set;
+  if (!final_mask) {
+    print_set(t->final, 0);
+    return;
+  }
+  set = new_set(0);
+  for (i = 1; i < final[0]; i++)
+    if (t->accept & ((uint64_t)1 << (i - 1)))
+      add_set(set, final[i]);
+  print_set(set, 0);
+  free_set(set, 0);
+}
+
+void touch_gstate(GState *s) /* records that a state has changed, and puts
+                                 it in the worklist */
+{
+  if (s->dirty <= gtrans_mark) { /* not in the worklist */
+    if (gwork_count == gwork_size) {
+      GState **tmp =
+          (GState **)tl_emalloc(2 * (gwork_size + 1) * sizeof(GState *));
+      if (gwork) {
+        memcpy(tmp, gwork, gwork_size * sizeof(GState *));
+        tfree(gwork);
+      }
+      gwork = tmp;
+      gwork_size = 2 * (gwork_size + 1);
+    }
+    gwork[gwork_count++] = s;
+  }
+  s->dirty = gpass;
+}
+
+void add_gpred(GState *s, GState *p) /* p has a transition to s */
+{
+  GPred *e;
+  if (s->pred && s->pred->gstate == p)
+    return;
+  e = (GPred *)slab_alloc(sizeof(GPred));
+  e->gstate = p;
+  e->nxt = s->pred;
+  s->pred = e;
+}
+
+void free_gpred(GState *s) {
+  GPred *e;
+  while ((e = s->pred)) {
+    s->pred = e->nxt;
+    slab_free(e, sizeof(GPred));
+  }
+}
+
 void copy_gtrans(GTrans *from, GTrans *to) /* copies a transition */
 {
   to->to = from->to;
-  copy_set(from->pos, to->pos, 1);
-  copy_set(from->neg, to->neg, 1);
-  copy_set(from->final, to->final, 0);
+  to->pos = from->pos;
+  to->neg = from->neg;
+  to->label = from->label;
+  copy_final(from, to);
 }
 
 int same_gtrans(GState *a, GTrans *s, GState *b, GTrans *t,
                 int use_scc) { /* returns 1 if the transitions are identical */
-  if ((s->to != t->to) || !same_sets(s->pos, t->pos, 1) ||
-      !same_sets(s->neg, t->neg, 1))
+  if ((s->to != t->to) || s->label != t->label)
     return 0; /* transitions differ */
-  if (same_sets(s->final, t->final, 0))
+  if (same_final(s, t))
     return 1; /* same transitions exactly */
   /* next we check whether acceptance conditions may be ignored */
   if (use_scc &&
@@ -114,44 +222,48 @@ int same_gtrans(GState *a, GTrans *s, GState *b, GTrans *t,
   return 1; /* same transitions up to acceptance conditions */
 }
 
-int simplify_gtrans() /* simplifies the transitions */
+int simplify_gtrans() /* simplifies the transitions of the states in the
+                         worklist; the other ones have not changed since they
+                         were last simplified */
 {
-  int changed = 0;
+  int changed = 0, i, n = gwork_count;
   GState *s;
   GTrans *t, *t1;
 
   if (tl_stats)
     getrusage(RUSAGE_SELF, &tr_debut);
 
-  for (s = gstates->nxt; s != gstates; s = s->nxt) {
+  gtrans_mark = ++gpass;
+  for (i = 0; i < n; i++) {
+    s = gwork[i];
+    if (!s->trans) /* s has been removed */
+      continue;
+    gvisit++;
     t = s->trans->nxt;
     while (t != s->trans) { /* tries to remove t */
       copy_gtrans(t, s->trans);
       t1 = s->trans->nxt;
       while (!((t != t1) && (t1->to == t->to) &&
-               included_set(t1->pos, t->pos, 1) &&
-               included_set(t1->neg, t->neg, 1) &&
-               (included_set(t->final, t1->final,
-                             0) /* acceptance conditions of t are also in t1 or
-                                   may be ignored */
+               included_label(t1->label, t->label) &&
+               (included_final(t, t1) /* acceptance conditions of t are
+                                         also in t1 or may be ignored */
                 || (tl_simp_scc && ((s->incoming != t->to->incoming) ||
                                     in_set(bad_scc, s->incoming))))))
         t1 = t1->nxt;
       if (t1 != s->trans) { /* remove transition t */
         GTrans *free = t->nxt;
-        t->to = free->to;
-        copy_set(free->pos, t->pos, 1);
-        copy_set(free->neg, t->neg, 1);
-        copy_set(free->final, t->final, 0);
+        copy_gtrans(free, t);
         t->nxt = free->nxt;
         if (free == s->trans)
           s->trans = t;
         free_gtrans(free, 0, 0);
+        touch_gstate(s);
         changed++;
       } else
         t = t->nxt;
     }
   }
+  gwork_count = 0;
 
   if (tl_stats) {
     getrusage(RUSAGE_SELF, &tr_fin);
@@ -166,41 +278,59 @@ int simplify_gtrans() /* simplifies the transitions */
   return changed;
 }
 
-void retarget_all_gtrans() { /* redirects transitions before removing a state
-                                from the automaton */
-  GState *s;
+int retarget_gtrans(GState *s, int pred) { /* redirects the transitions of s
+                                              to removed states */
   GTrans *t;
+  int changed = 0;
+  for (t = s->trans->nxt; t != s->trans;)
+    if (!t->to->trans) { /* t->to has been removed */
+      changed = 1;
+      t->to = redirect_gstate(t->to);
+      if (!t->to) { /* t->to has no transitions */
+        GTrans *free = t->nxt;
+        copy_gtrans(free, t);
+        t->nxt = free->nxt;
+        if (free == s->trans)
+          s->trans = t;
+        free_gtrans(free, 0, 0);
+      } else {
+        if (pred)
+          add_gpred(t->to, s);
+        t = t->nxt;
+      }
+    } else
+      t = t->nxt;
+  return changed;
+}
+
+void retarget_init() {
   int i;
   for (i = 0; i < init_size; i++)
     if (init[i] && !init[i]->trans) /* init[i] has been removed */
-      init[i] = init[i]->prv;
-  for (s = gstates->nxt; s != gstates; s = s->nxt)
-    for (t = s->trans->nxt; t != s->trans;)
-      if (!t->to->trans) { /* t->to has been removed */
-        t->to = t->to->prv;
-        if (!t->to) { /* t->to has no transitions */
-          GTrans *free = t->nxt;
-          t->to = free->to;
-          copy_set(free->pos, t->pos, 1);
-          copy_set(free->neg, t->neg, 1);
-          copy_set(free->final, t->final, 0);
-          t->nxt = free->nxt;
-          if (free == s->trans)
-            s->trans = t;
-          free_gtrans(free, 0, 0);
-        } else
-          t = t->nxt;
-      } else
-        t = t->nxt;
-  while (gremoved->nxt != gremoved) { /* clean the 'removed' list */
+      init[i] = redirect_gstate(init[i]);
+}
+
+void free_gremoved() { /* clean the 'removed' list */
+  GState *s;
+  while (gremoved->nxt != gremoved) {
     s = gremoved->nxt;
     gremoved->nxt = gremoved->nxt->nxt;
     if (s->nodes_set)
-      tfree(s->nodes_set);
-    tfree(s);
+      free_packed(s->nodes_set, 0);
+    free_gpred(s);
+    slab_free(s, sizeof(GState));
   }
 }
 
+void retarget_all_gtrans() { /* redirects transitions before removing a state
+                                from the automaton */
+  GState *s;
+  retarget_init();
+  for (s = gstates->nxt; s != gstates; s = s->nxt)
+    retarget_gtrans(s, 0);
+  free_gremoved();
+}
+
 int all_gtrans_match(GState *a, GState *b,
                      int use_scc) { /* decides if the states are equivalent */
   GTrans *s, *t;
@@ -225,35 +355,107 @@ int all_gtrans_match(GState *a, GState *b,
   return 1;
 }
 
+static int cmp_hash(const void *x, const void *y) {
+  unsigned long a = *(const unsigned long *)x, b = *(const unsigned long *)y;
+  return (a > b) - (a < b);
+}
+
+unsigned long gstate_signature(GState *s) { /* hashes the labels and targets
+                                               of the transitions of a state,
+                                               but not their acceptance */
+  GTrans *t;
+  int i, n = 0;
+  unsigned long h = 0;
+  for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+    if (n == sig_size) { /* the buffer is full */
+      unsigned long *tmp = (unsigned long *)tl_emalloc(
+          2 * (sig_size + 1) * sizeof(unsigned long));
+      if (sig_buf) {
+        memcpy(tmp, sig_buf, sig_size * sizeof(unsigned long));
+        tfree(sig_buf);
+      }
+      sig_buf = tmp;
+      sig_size = 2 * (sig_size + 1);
+    }
+    sig_buf[n] = label_hash(t->label) * 31 + (unsigned long)t->to->id;
+    n++;
+  }
+  qsort(sig_buf, n, sizeof(unsigned long), cmp_hash);
+  for (i = 0; i < n; i++)
+    if (i == 0 || sig_buf[i] != sig_buf[i - 1]) /* a set, not a multiset */
+      h = (h ^ sig_buf[i]) * 1099511628211UL;
+  return h;
+}
+
 int simplify_gstates() /* eliminates redundant states */
 {
-  int changed = 0;
-  GState *a, *b;
+  int changed = 0, i, j, n, size, mark = gstates_mark, *next, *bucket;
+  GState *a, *b, **order, *removed = gremoved->nxt;
+  GPred *p;
 
   if (tl_stats)
     getrusage(RUSAGE_SELF, &tr_debut);
 
-  for (a = gstates->nxt; a != gstates; a = a->nxt) {
+  /* equivalent states have the same signature: only the states of the same
+     bucket, later in the list, are compared with all_gtrans_match; two states
+     that have not changed since the last call have already been compared */
+  gstates_mark = ++gpass;
+  for (n = 0, a = gstates->nxt; a != gstates; a = a->nxt)
+    n++;
+  for (size = 1; size < n; size *= 2)
+    ;
+  order = (GState **)tl_emalloc((n + 1) * sizeof(GState *));
+  next = (int *)tl_emalloc((n + 1) * sizeof(int));
+  bucket = (int *)tl_emalloc(size * sizeof(int));
+  for (i = 0, a = gstates->nxt; a != gstates; a = a->nxt, i++) {
+    order[i] = a;
+    if (a->dirty >= mark)
+      a->sig = gstate_signature(a);
+  }
+  for (i = n - 1; i >= 0; i--) { /* buckets list the states in order */
+    next[i] = bucket[order[i]->sig & (size - 1)];
+    bucket[order[i]->sig & (size - 1)] = i + 1;
+  }
+
+  for (i = 0; i < n; i++) {
+    if (!(a = order[i])) /* a has been removed */
+      continue;
     if (a->trans == a->trans->nxt) { /* a has no transitions */
-      a = remove_gstate(a, (GState *)0);
+      remove_gstate(a, (GState *)0);
+      order[i] = (GState *)0;
       changed++;
       continue;
     }
-    gstates->trans = a->trans;
-    b = a->nxt;
-    while (!all_gtrans_match(a, b, tl_simp_scc))
-      b = b->nxt;
-    if (b != gstates) { /* a and b are equivalent */
+    for (j = next[i]; j; j = next[j - 1])
+      if ((b = order[j - 1]) && b->sig == a->sig &&
+          (a->dirty >= mark || b->dirty >= mark) && ++gcompare &&
+          all_gtrans_match(a, b, tl_simp_scc))
+        break;
+    if (j) { /* a and b are equivalent */
       /* if scc(a)>scc(b) and scc(a) is non-trivial then
        * all_gtrans_match(a,b,use_scc) must fail */
-      if (a->incoming > b->incoming) /* scc(a) is trivial */
-        a = remove_gstate(a, b);
-      else /* either scc(a)=scc(b) or scc(b) is trivial */
+      if (a->incoming > b->incoming) { /* scc(a) is trivial */
+        remove_gstate(a, b);
+        order[i] = (GState *)0;
+        touch_gstate(b);
+      } else { /* either scc(a)=scc(b) or scc(b) is trivial */
         remove_gstate(b, a);
+        order[j - 1] = (GState *)0;
+        touch_gstate(a);
+      }
       changed++;
     }
   }
-  retarget_all_gtrans();
+  tfree(order);
+  tfree(next);
+  tfree(bucket);
+
+  /* only the predecessors of the removed states have to be redirected */
+  retarget_init();
+  for (a = gremoved->nxt; a != removed; a = a->nxt)
+    for (p = a->pred; p; p = p->nxt)
+      if (p->gstate->trans && retarget_gtrans(p->gstate, 1))
+        touch_gstate(p->gstate);
 
   if (tl_stats) {
     getrusage(RUSAGE_SELF, &tr_fin);
@@ -263,170 +465,636 @@ int simplify_gstates() /* eliminates redundant states */
             "%ld.%06lis",
             t_diff.tv_sec, t_diff.tv_usec);
     fprintf(tl_out, "\n%i states removed\n", changed);
+    fprintf(tl_out, "round %i: %i states revisited, %i pairs compared\n",
+            ++ground, gvisit, gcompare);
   }
+  gvisit = gcompare = 0;
 
   return changed;
 }
 
-int gdfs(GState *s) {
-  GTrans *t;
+void gpush(GState *s) /* starts the exploration of a state */
+{
+  GScc *c = &gdfs_stack[gdfs_depth++];
+  c->gstate = s;
+  c->trans = s->trans->nxt;
+  c->rank = rank;
+  c->theta = rank++;
+  s->incoming = -c->rank; /* on the stack */
+  scc_stack[scc_top++] = s;
+}
+
+void gdfs(GState *s) { /* computes the SCCs reachable from s (Tarjan) */
   GScc *c;
-  GScc *scc = (GScc *)tl_emalloc(sizeof(GScc));
-  scc->gstate = s;
-  scc->rank = rank;
-  scc->theta = rank++;
-  scc->nxt = scc_stack;
-  scc_stack = scc;
+  GTrans *t;
+  gpush(s);
+  while (gdfs_depth > 0) {
+    c = &gdfs_stack[gdfs_depth - 1];
+    if (c->trans != c->gstate->trans) {
+      t = c->trans;
+      c->trans = t->nxt;
+      if (t->to->incoming == 0)
+        gpush(t->to);
+      else if (t->to->incoming < 0) /* t->to is on the stack */
+        c->theta = min(c->theta, -t->to->incoming);
+      continue;
+    }
+    if (c->rank == c->theta) { /* c->gstate is the root of an scc */
+      do {
+        s = scc_stack[--scc_top];
+        s->incoming = scc_id;
+      } while (s != c->gstate);
+      scc_id++;
+    }
+    if (--gdfs_depth > 0)
+      gdfs_stack[gdfs_depth - 1].theta =
+          min(gdfs_stack[gdfs_depth - 1].theta, c->theta);
+  }
+}
 
-  s->incoming = 1;
+void scc_acceptance(GState **member, int n, int lo, int hi,
+                    int *bad) { /* finds the bad sccs among lo..hi-1,
+                                   given all their states */
+  GState *s;
+  GTrans *t;
+  int i;
+  uint64_t **scc_final = (uint64_t **)0;
+  uint64_t *scc_accept = (uint64_t *)0;
+
+  if (final_mask)
+    scc_accept = (uint64_t *)tl_emalloc((hi - lo) * sizeof(uint64_t));
+  else {
+    scc_final = (uint64_t **)tl_emalloc((hi - lo) * sizeof(uint64_t *));
+    for (i = 0; i < hi - lo; i++)
+      scc_final[i] = make_set(-1, 0);
+  }
 
-  for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-    if (t->to->incoming == 0) {
-      int result = gdfs(t->to);
-      scc->theta = min(scc->theta, result);
-    } else {
-      for (c = scc_stack->nxt; c != 0; c = c->nxt)
-        if (c->gstate == t->to) {
-          scc->theta = min(scc->theta, c->rank);
-          break;
-        }
-    }
+  for (i = 0; i < n; i++)
+    for (s = member[i], t = s->trans->nxt; t != s->trans; t = t->nxt)
+      if (t->to->incoming == s->incoming) {
+        if (final_mask)
+          scc_accept[s->incoming - lo] |= t->accept;
+        else
+          merge_sets(scc_final[s->incoming - lo], t->final, 0);
+      }
+
+  for (i = 0; i < hi - lo; i++)
+    bad[i] = final_mask ? scc_accept[i] != all_finals
+                        : !included_set(final_set, scc_final[i], 0);
+
+  if (final_mask)
+    tfree(scc_accept);
+  else {
+    for (i = 0; i < hi - lo; i++)
+      free_set(scc_final[i], 0);
+    tfree(scc_final);
   }
-  if (scc->rank == scc->theta) {
-    while (scc_stack != scc) {
-      scc_stack->gstate->incoming = scc_id;
-      scc_stack = scc_stack->nxt;
+}
+
+void update_gscc(int mark) { /* recomputes the sccs holding a state changed
+                                since the last call, the others are kept */
+  GState *s, **member;
+  int i, j, k, m = 0, old_id = scc_id;
+  uint64_t *old_bad = bad_scc;
+  int *count, *touched, *old, *first, *next, *piece_count, *bad, *renum;
+
+  count = (int *)tl_emalloc(old_id * sizeof(int));
+  touched = (int *)tl_emalloc(old_id * sizeof(int));
+  for (s = gstates->nxt; s != gstates; s = s->nxt) {
+    count[s->incoming]++;
+    if (s->dirty > mark)
+      touched[s->incoming] = 1;
+  }
+  for (s = gstates->nxt; s != gstates; s = s->nxt)
+    if (touched[s->incoming])
+      m++;
+  if (!m) {
+    tfree(count);
+    tfree(touched);
+    return;
+  }
+
+  /* the states of the other sccs are not white: Tarjan stays inside the
+     touched sccs, which may only split (merged states have the same
+     successors, and the removed one is never below the other one) */
+  member = (GState **)tl_emalloc(m * sizeof(GState *));
+  old = (int *)tl_emalloc(m * sizeof(int));
+  for (i = 0, s = gstates->nxt; s != gstates; s = s->nxt)
+    if (touched[s->incoming]) {
+      member[i] = s;
+      old[i++] = s->incoming;
+      s->incoming = 0; /* state color = white */
     }
-    scc->gstate->incoming = scc_id++;
-    scc_stack = scc->nxt;
+  gdfs_stack = (GScc *)tl_emalloc(m * sizeof(GScc));
+  scc_stack = (GState **)tl_emalloc(m * sizeof(GState *));
+  gdfs_depth = scc_top = 0;
+  for (i = 0; i < m; i++)
+    if (member[i]->incoming == 0)
+      gdfs(member[i]);
+  tfree(gdfs_stack);
+  tfree(scc_stack);
+
+  /* the pieces old_id..scc_id-1 of each touched scc, in the order found */
+  first = (int *)tl_emalloc(old_id * sizeof(int));
+  next = (int *)tl_emalloc((scc_id - old_id) * sizeof(int));
+  piece_count = (int *)tl_emalloc((scc_id - old_id) * sizeof(int));
+  bad = (int *)tl_emalloc((scc_id - old_id) * sizeof(int));
+  for (i = 0; i < m; i++)
+    if (!piece_count[member[i]->incoming - old_id]++)
+      next[member[i]->incoming - old_id] = old[i];
+  for (k = scc_id - old_id - 1; k >= 0; k--) {
+    j = next[k];
+    next[k] = first[j];
+    first[j] = k + 1;
+  }
+  scc_acceptance(member, m, old_id, scc_id, bad);
+  for (i = 0; i < m; i++) { /* the states whose scc changed */
+    k = member[i]->incoming - old_id;
+    if (piece_count[k] != count[old[i]] || !bad[k] != !in_set(old_bad, old[i]))
+      touch_gstate(member[i]);
   }
-  return scc->theta;
+
+  /* the pieces take the place of their scc: the numbering stays a reverse
+     topological order, which simplify_gstates relies on */
+  renum = (int *)tl_emalloc(scc_id * sizeof(int));
+  for (j = 1, i = 1; i < old_id; i++)
+    if (!touched[i])
+      renum[i] = count[i] ? j++ : 0;
+    else
+      for (k = first[i]; k; k = next[k - 1])
+        renum[old_id + k - 1] = j++;
+  for (s = gstates->nxt; s != gstates; s = s->nxt)
+    s->incoming = renum[s->incoming];
+
+  scc_size = (j + 1) / (8 * sizeof(uint64_t)) + 1;
+  init_set_ops(2);
+  bad_scc = make_set(-1, 2);
+  for (i = 1; i < old_id; i++)
+    if (!touched[i] && count[i] && in_set(old_bad, i))
+      add_set(bad_scc, renum[i]);
+  for (k = 0; k < scc_id - old_id; k++)
+    if (bad[k])
+      add_set(bad_scc, renum[old_id + k]);
+
+  scc_id = j;
+
+  tfree(count);
+  tfree(touched);
+  tfree(member);
+  tfree(old);
+  tfree(first);
+  tfree(next);
+  tfree(piece_count);
+  tfree(bad);
+  tfree(renum);
+  free_set(old_bad, 2);
 }
 
 void simplify_gscc() {
-  GState *s;
-  GTrans *t;
-  int i, **scc_final;
+  GState *s, **member;
+  int i, n, *bad, mark = gscc_mark;
   rank = 1;
-  scc_stack = 0;
-  scc_id = 1;
+  gscc_mark = ++gpass;
 
   if (gstates == gstates->nxt)
     return;
 
-  for (s = gstates->nxt; s != gstates; s = s->nxt)
+  if (bad_scc) { /* the sccs have been computed once already */
+    update_gscc(mark);
+    return;
+  }
+
+  scc_id = 1;
+  for (n = 0, s = gstates->nxt; s != gstates; s = s->nxt, n++)
     s->incoming = 0; /* state color = white */
 
+  gdfs_stack = (GScc *)tl_emalloc(n * sizeof(GScc));
+  scc_stack = (GState **)tl_emalloc(n * sizeof(GState *));
+  gdfs_depth = scc_top = 0;
   for (i = 0; i < init_size; i++)
     if (init[i] && init[i]->incoming == 0)
       gdfs(init[i]);
+  tfree(gdfs_stack);
+  tfree(scc_stack);
 
-  scc_final = (int **)tl_emalloc(scc_id * sizeof(int *));
-  for (i = 0; i < scc_id; i++)
-    scc_final[i] = make_set(-1, 0);
-
-  for (s = gstates->nxt; s != gstates; s = s->nxt)
+  member = (GState **)tl_emalloc(n * sizeof(GState *));
+  for (n = 0, s = gstates->nxt; s != gstates; s = s->nxt)
     if (s->incoming == 0)
       s = remove_gstate(s, 0);
     else
-      for (t = s->trans->nxt; t != s->trans; t = t->nxt)
-        if (t->to->incoming == s->incoming)
-          merge_sets(scc_final[s->incoming], t->final, 0);
+      member[n++] = s;
 
-  scc_size = (scc_id + 1) / (8 * sizeof(int)) + 1;
+  bad = (int *)tl_emalloc(scc_id * sizeof(int));
+  scc_acceptance(member, n, 0, scc_id, bad);
+  scc_size = (scc_id + 1) / (8 * sizeof(uint64_t)) + 1;
+  init_set_ops(2);
   bad_scc = make_set(-1, 2);
-
   for (i = 0; i < scc_id; i++)
-    if (!included_set(final_set, scc_final[i], 0))
+    if (bad[i])
       add_set(bad_scc, i);
 
-  for (i = 0; i < scc_id; i++)
-    tfree(scc_final[i]);
-  tfree(scc_final);
+  tfree(member);
+  tfree(bad);
+}
+
+int simplify_gfinal() { /* removes the acceptance conditions that are implied
+                           by the others in every scc */
+  GState *s;
+  GTrans *t;
+  int i, j, c, n = final[0] - 1, removed = 0, ok;
+  uint64_t bit, kept = all_finals, *present, *always, *implied, m;
+
+  if (!final_mask || n == 0 || gstates == gstates->nxt)
+    return 0;
+
+  /* for each scc: the conditions met inside it, the ones met by all its
+     transitions, and for each condition i the ones met with i */
+  present = (uint64_t *)tl_emalloc(scc_id * sizeof(uint64_t));
+  always = (uint64_t *)tl_emalloc(scc_id * sizeof(uint64_t));
+  implied = (uint64_t *)tl_emalloc(scc_id * n * sizeof(uint64_t));
+  for (c = 0; c < scc_id; c++) {
+    always[c] = all_finals;
+    for (i = 0; i < n; i++)
+      implied[c * n + i] = all_finals;
+  }
+  for (s = gstates->nxt; s != gstates; s = s->nxt)
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+      if (t->to->incoming == s->incoming) {
+        c = s->incoming;
+        present[c] |= t->accept;
+        always[c] &= t->accept;
+        for (m = t->accept; m; m &= m - 1)
+          implied[c * n + __builtin_ctzll(m)] &= t->accept;
+      }
+
+  /* j can go if every scc missing j also misses another kept condition, or
+     has j on all the transitions where some other kept condition is */
+  for (j = 0; j < n; j++) {
+    bit = (uint64_t)1 << j;
+    kept &= ~bit;
+    for (ok = 1, c = 1; ok && c < scc_id; c++) {
+      if ((present[c] & kept) != kept || (always[c] & bit))
+        continue;
+      for (ok = 0, m = kept; m && !ok; m &= m - 1)
+        ok = (implied[c * n + __builtin_ctzll(m)] & bit) != 0;
+    }
+    if (!ok)
+      kept |= bit;
+    else
+      removed++;
+  }
+  tfree(present);
+  tfree(always);
+  tfree(implied);
+
+  if (!removed)
+    return 0;
+
+  gpass++;
+  for (s = gstates->nxt; s != gstates; s = s->nxt) {
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      for (m = 0, i = 0, j = 0; j < n; j++)
+        if (kept & ((uint64_t)1 << j))
+          m |= ((t->accept >> j) & 1) << i++;
+      t->accept = m;
+    }
+    touch_gstate(s); /* every state is to be simplified again */
+  }
+  for (i = 1, j = 0; j < n; j++)
+    if (kept & ((uint64_t)1 << j))
+      final[i++] = final[j + 1];
+    else
+      rem_set(final_set, final[j + 1]);
+  final[0] = i;
+  all_finals = final[0] > 1 ? ~(uint64_t)0 >> (65 - final[0]) : 0;
+
+  if (tl_stats)
+    fprintf(tl_out, "\n%i acceptance conditions removed\n", removed);
+  return removed;
 }
 
 /********************************************************************\
 |*        Generation of the generalized Buchi automaton             *|
 \********************************************************************/
 
-int is_final(int *from, ATrans *at, int i) /*is the transition final for i ?*/
+typedef struct FCache { /* acceptance conditions fulfilled by a label */
+  uint64_t *label; /* pos|neg|to */
+  uint64_t *exits;
+  unsigned long hash;
+  struct FCache *nxt;
+} FCache;
+
+typedef struct GProd { /* a transition computed before its target state is
+                          looked up */
+  uint64_t *to;
+  uint64_t *pos;
+  uint64_t *neg;
+  uint64_t *final;
+  int alive; /* 0 if a later transition made it redondant */
+  struct GProd *nxt;
+} GProd;
+
+typedef struct GRange { /* a part of the product of a state */
+  uint64_t *nodes_set;
+  ATrans *from;
+  ATrans *upto;
+  GProd *result;
+  pthread_t thread;
+} GRange;
+
+typedef struct GEntry { /* a state in one of the indexes below */
+  GState *gstate;
+  unsigned long hash;
+  int where; /* list containing the state (IN_...) */
+  int stamp; /* when the state entered this list */
+  int work;  /* exploration by the worker threads (W_...) */
+  GProd *prod;
+  struct GEntry *created;
+  struct GEntry *nxt;
+} GEntry;
+
+typedef struct GTable {
+  GEntry **bucket;
+  int size;
+  int count;
+} GTable;
+
+#define SPLIT_SIZE 4096 /* products split between threads */
+
+/* lists in the order of priority of find_gstate */
+enum { IN_NONE, IN_REMOVED, IN_STATES, IN_STACK };
+enum { W_IDLE, W_QUEUED, W_RUNNING, W_DONE };
+
+static ATrans **exit_trans; /* transitions leaving each acceptance node */
+static __thread FCache **fcache;
+static __thread int fcache_size, fcache_count;
+static __thread int *gkey;
+static GTable gindex; /* states by nodes_set */
+static GTable gsigs;  /* solved states by signature, newest first */
+static GEntry *gcreated;
+static int gstamp;
+
+static pthread_t *workers;
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_todo = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+static GEntry **work_stack;
+static int work_top, work_size, work_stop;
+
+void init_explore() /* allocates the buffers of the current thread */
+{
+  fcache_size = 256;
+  fcache_count = 0;
+  fcache = (FCache **)tl_emalloc(fcache_size * sizeof(FCache *));
+  gkey = (int *)tl_emalloc(
+      (final[0] + (node_size + 2 * sym_size) * 8 * sizeof(uint64_t)) * sizeof(int));
+}
+
+void free_explore() /* frees the buffers of the current thread */
+{
+  int i;
+  FCache *c;
+  for (i = 0; i < fcache_size; i++)
+    while ((c = fcache[i])) {
+      fcache[i] = c->nxt;
+      free_set(c->label, LABEL_NODES);
+      free_set(c->exits, 0);
+      slab_free(c, sizeof(FCache));
+    }
+  tfree(fcache);
+  tfree(gkey);
+}
+
+void make_exit_trans() /* indexes the transitions that leave a node */
 {
+  int i;
   ATrans *t;
-  int in_to;
-  if ((tl_fjtofj && !in_set(at->to, i)) || (!tl_fjtofj && !in_set(from, i)))
-    return 1;
-  in_to = in_set(at->to, i);
-  rem_set(at->to, i);
-  for (t = transition[i]; t; t = t->nxt)
-    if (included_set(t->to, at->to, 0) && included_set(t->pos, at->pos, 1) &&
-        included_set(t->neg, at->neg, 1)) {
-      if (in_to)
-        add_set(at->to, i);
-      return 1;
+  exit_trans = (ATrans **)tl_emalloc(node_id * sizeof(ATrans *));
+  for (i = 1; i < final[0]; i++)
+    for (t = transition[final[i]]; t; t = t->nxt)
+      if (!in_set(t->to, final[i])) {
+        ATrans *tmp = dup_trans(t);
+        tmp->nxt = exit_trans[final[i]];
+        exit_trans[final[i]] = tmp;
+      }
+}
+
+void free_exit_trans() /* frees the index */
+{
+  int i;
+  for (i = 1; i < final[0]; i++)
+    free_atrans(exit_trans[final[i]], 1);
+  tfree(exit_trans);
+}
+
+void grow_fcache() /* doubles the number of buckets of the cache */
+{
+  int i;
+  FCache *c, **old = fcache;
+  fcache = (FCache **)tl_emalloc(2 * fcache_size * sizeof(FCache *));
+  for (i = 0; i < fcache_size; i++)
+    while ((c = old[i])) {
+      old[i] = c->nxt;
+      c->nxt = fcache[c->hash & (2 * fcache_size - 1)];
+      fcache[c->hash & (2 * fcache_size - 1)] = c;
     }
-  if (in_to)
-    add_set(at->to, i);
-  return 0;
+  fcache_size *= 2;
+  tfree(old);
+}
+
+uint64_t *exit_final(ATrans *at) /* acceptance nodes left by the transition */
+{
+  int i;
+  ATrans *t;
+  FCache *c;
+  unsigned long h = hash_set(at->pos, LABEL_NODES);
+
+  for (c = fcache[h & (fcache_size - 1)]; c; c = c->nxt)
+    if (c->hash == h && same_sets(c->label, at->pos, LABEL_NODES))
+      return c->exits;
+
+  c = (FCache *)slab_alloc(sizeof(FCache));
+  c->label = dup_set(at->pos, LABEL_NODES);
+  c->exits = make_set(-1, 0);
+  c->hash = h;
+  for (i = 1; i < final[0]; i++)
+    for (t = exit_trans[final[i]]; t; t = t->nxt)
+      if (included_set(t->pos, at->pos, LABEL_NODES)) {
+        add_set(c->exits, final[i]);
+        break;
+      }
+  c->nxt = fcache[h & (fcache_size - 1)];
+  fcache[h & (fcache_size - 1)] = c;
+  if (++fcache_count > fcache_size)
+    grow_fcache();
+  return c->exits;
+}
+
+void make_final(uint64_t *from, ATrans *at,
+                uint64_t *result) /* the transition is final for i if it does not
+                                keep i active or if it leaves i */
+{
+  do_diff_sets(result, final_set, tl_fjtofj ? at->to : from, 0);
+  merge_sets(result, exit_final(at), 0);
+}
+
+void gtable_init(GTable *t) {
+  t->size = 256;
+  t->count = 0;
+  t->bucket = (GEntry **)tl_emalloc(t->size * sizeof(GEntry *));
+}
+
+void gtable_free(GTable *t) {
+  int i;
+  GEntry *e;
+  for (i = 0; i < t->size; i++)
+    while ((e = t->bucket[i])) {
+      t->bucket[i] = e->nxt;
+      slab_free(e, sizeof(GEntry));
+    }
+  tfree(t->bucket);
+}
+
+GEntry *gtable_add(GTable *t, GState *s,
+                   unsigned long h) { /* adds s at the head of its bucket */
+  int i;
+  GEntry *e = (GEntry *)slab_alloc(sizeof(GEntry));
+  e->gstate = s;
+  e->hash = h;
+  e->nxt = t->bucket[h & (t->size - 1)];
+  t->bucket[h & (t->size - 1)] = e;
+  if (++t->count > t->size) { /* doubles the number of buckets */
+    GEntry *f, *rev, **old = t->bucket;
+    t->bucket = (GEntry **)tl_emalloc(2 * t->size * sizeof(GEntry *));
+    for (i = 0; i < t->size; i++) {
+      for (rev = 0; (f = old[i]);) { /* keeps the order of the buckets */
+        old[i] = f->nxt;
+        f->nxt = rev;
+        rev = f;
+      }
+      while ((f = rev)) {
+        rev = f->nxt;
+        f->nxt = t->bucket[f->hash & (2 * t->size - 1)];
+        t->bucket[f->hash & (2 * t->size - 1)] = f;
+      }
+    }
+    t->size *= 2;
+    tfree(old);
+  }
+  return e;
+}
+
+void gtable_remove(GTable *t, GEntry *e) {
+  GEntry **p = &t->bucket[e->hash & (t->size - 1)];
+  while (*p != e)
+    p = &(*p)->nxt;
+  *p = e->nxt;
+  t->count--;
+  slab_free(e, sizeof(GEntry));
+}
+
+GEntry *gstate_entry(GState *s) /* the entry of s in 'gindex' */
+{
+  GEntry *e = gindex.bucket[s->hash & (gindex.size - 1)];
+  while (e->gstate != s)
+    e = e->nxt;
+  return e;
+}
+
+void move_gstate(GEntry *e, int where) /* records a change of list */
+{
+  e->where = where;
+  e->stamp = gstamp++;
 }
 
 GState *
-find_gstate(int *set,
+find_gstate(uint64_t *set,
             GState *s) { /* finds the corresponding state, or creates it */
+  GEntry *e, *best = (GEntry *)0;
+  unsigned long h = hash_set(set, 0);
+  int n = count_set(set, 0);
 
-  if (same_sets(set, s->nodes_set, 0))
+  if (h == s->hash && same_packed(s->nodes_set, set, n, 0))
     return s; /* same state */
 
-  s = gstack->nxt; /* in the stack */
-  gstack->nodes_set = set;
-  while (!same_sets(set, s->nodes_set, 0))
-    s = s->nxt;
-  if (s != gstack)
-    return s;
-
-  s = gstates->nxt; /* in the solved states */
-  gstates->nodes_set = set;
-  while (!same_sets(set, s->nodes_set, 0))
-    s = s->nxt;
-  if (s != gstates)
-    return s;
-
-  s = gremoved->nxt; /* in the removed states */
-  gremoved->nodes_set = set;
-  while (!same_sets(set, s->nodes_set, 0))
-    s = s->nxt;
-  if (s != gremoved)
-    return s;
-
-  s = (GState *)tl_emalloc(sizeof(GState)); /* creates a new state */
-  s->id = (empty_set(set, 0)) ? 0 : gstate_id++;
+  /* several initial states may have the same set: the one found first by
+     searching the stack, the solved states, then the removed states, each
+     from its head, is the one which entered the list last */
+  for (e = gindex.bucket[h & (gindex.size - 1)]; e; e = e->nxt)
+    if (e->hash == h && e->where != IN_NONE &&
+        same_packed(e->gstate->nodes_set, set, n, 0) &&
+        (!best || e->where > best->where ||
+         (e->where == best->where && e->stamp > best->stamp)))
+      best = e;
+  if (best)
+    return best->gstate;
+
+  s = (GState *)slab_alloc(sizeof(GState)); /* creates a new state */
+  s->id = n ? gstate_id++ : 0;
   s->incoming = 0;
-  s->nodes_set = dup_set(set, 0);
+  s->nodes_set = pack_set(set, 0);
+  s->hash = h;
   s->trans = emalloc_gtrans(); /* sentinel */
   s->trans->nxt = s->trans;
   s->nxt = gstack->nxt;
   gstack->nxt = s;
+  e = gtable_add(&gindex, s, h);
+  move_gstate(e, IN_STACK);
+  e->created = gcreated;
+  gcreated = e;
   return s;
 }
 
-void make_gtrans(GState *s) { /* creates all the transitions from a state */
-  int i, *list, state_trans = 0, trans_exist = 1;
-  GState *s1;
+int gtrans_key(int *key, uint64_t *to, uint64_t *pos, uint64_t *neg,
+               uint64_t *fin) /* lists the label of a transition for the index:
+                            acceptance conditions (in or out), then the
+                            target nodes and the literals */
+{
+  int i, n = 0, offset = 2 * final[0];
+  for (i = 1; i < final[0]; i++)
+    key[n++] = 2 * i + (in_set(fin, final[i]) != 0);
+  n += fill_list(to, 0, key + n, offset);
+  offset += node_size * 8 * sizeof(uint64_t);
+  n += fill_list(pos, 1, key + n, offset);
+  offset += sym_size * 8 * sizeof(uint64_t);
+  n += fill_list(neg, 1, key + n, offset);
+  return n;
+}
+
+void free_gprod(GProd *r) {
+  GProd *nxt;
+  for (; r; r = nxt) {
+    nxt = r->nxt;
+    free_set(r->pos, LABEL_NODES);
+    free_set(r->final, 0);
+    slab_free(r, sizeof(GProd));
+  }
+}
+
+GProd *explore_range(uint64_t *nodes_set, ATrans *from,
+                     ATrans *upto) { /* computes the transitions from a set of
+                                        nodes whose factor for the first node
+                                        is between from and upto (excluded),
+                                        in the order in which they are found;
+                                        this only reads shared data */
+  int i, trans_exist = 1;
+  uint64_t *fin = new_set(0);
+  SetIter it;
   ATrans *t1;
-  AProd *prod = (AProd *)tl_emalloc(sizeof(AProd)); /* initialization */
+  GProd *r, *result = (GProd *)0, **last = &result;
+  STrie *index = tl_simp_fly ? new_strie() : (STrie *)0;
+  AProd *prod = (AProd *)slab_alloc(sizeof(AProd)); /* initialization */
   prod->nxt = prod;
   prod->prv = prod;
   prod->prod = emalloc_atrans();
-  clear_set(prod->prod->to, 0);
-  clear_set(prod->prod->pos, 1);
-  clear_set(prod->prod->neg, 1);
+  clear_set(prod->prod->pos, LABEL_NODES);
   prod->trans = prod->prod;
   prod->trans->nxt = prod->prod;
-  list = list_set(s->nodes_set, 0);
 
-  for (i = 1; i < list[0]; i++) {
-    AProd *p = (AProd *)tl_emalloc(sizeof(AProd));
-    p->astate = list[i];
-    p->trans = transition[list[i]];
+  for (first_elem(&it, nodes_set, 0); (i = next_elem(&it)) != -1;) {
+    AProd *p = (AProd *)slab_alloc(sizeof(AProd));
+    p->astate = i;
+    p->trans = (prod->nxt == prod) ? from : transition[i];
     if (!p->trans)
       trans_exist = 0;
     p->prod = merge_trans(prod->nxt->prod, p->trans);
@@ -440,51 +1108,35 @@ void make_gtrans(GState *s) { /* creates all the transitions from a state */
     AProd *p = prod->nxt;
     t1 = p->prod;
     if (t1) { /* solves the current transition */
-      GTrans *trans, *t2;
-      clear_set(fin, 0);
-      for (i = 1; i < final[0]; i++)
-        if (is_final(s->nodes_set, t1, final[i]))
-          add_set(fin, final[i]);
-      for (t2 = s->trans->nxt; t2 != s->trans;) {
-        if (tl_simp_fly && included_set(t1->to, t2->to->nodes_set, 0) &&
-            included_set(t1->pos, t2->pos, 1) &&
-            included_set(t1->neg, t2->neg, 1) &&
-            same_sets(fin, t2->final, 0)) { /* t2 is redondant */
-          GTrans *free = t2->nxt;
-          t2->to->incoming--;
-          t2->to = free->to;
-          copy_set(free->pos, t2->pos, 1);
-          copy_set(free->neg, t2->neg, 1);
-          copy_set(free->final, t2->final, 0);
-          t2->nxt = free->nxt;
-          if (free == s->trans)
-            s->trans = t2;
-          free_gtrans(free, 0, 0);
-          state_trans--;
-        } else if (tl_simp_fly && included_set(t2->to->nodes_set, t1->to, 0) &&
-                   included_set(t2->pos, t1->pos, 1) &&
-                   included_set(t2->neg, t1->neg, 1) &&
-                   same_sets(t2->final, fin, 0)) { /* t1 is redondant */
-          break;
-        } else {
-          t2 = t2->nxt;
+      int n = 0;
+      make_final(nodes_set, t1, fin);
+      if (tl_simp_fly) {
+        STrie *f, *nf;
+        n = gtrans_key(gkey, t1->to, t1->pos, t1->neg, fin);
+        for (f = strie_supersets(index, gkey, n); f; f = nf) {
+          nf = f->found; /* the transition is redondant */
+          ((GProd *)f->item)->alive = 0;
+          strie_remove(f);
         }
       }
-      if (t2 == s->trans) { /* adds the transition */
-        trans = emalloc_gtrans();
-        trans->to = find_gstate(t1->to, s);
-        trans->to->incoming++;
-        copy_set(t1->pos, trans->pos, 1);
-        copy_set(t1->neg, trans->neg, 1);
-        copy_set(fin, trans->final, 0);
-        trans->nxt = s->trans->nxt;
-        s->trans->nxt = trans;
-        state_trans++;
+      if (!tl_simp_fly || !strie_subset(index, gkey, n)) {
+        /* adds the transition, unless t1 is redondant */
+        r = (GProd *)slab_alloc(sizeof(GProd));
+        r->pos = dup_set(t1->pos, LABEL_NODES); /* pos|neg|to */
+        r->neg = r->pos + sym_size;
+        r->to = r->neg + sym_size;
+        r->final = dup_set(fin, 0);
+        r->alive = 1;
+        *last = r;
+        last = &r->nxt;
+        if (tl_simp_fly)
+          strie_insert(index, gkey, n, r);
       }
     }
     if (!p->trans)
       break;
-    while (!p->trans->nxt) /* calculates the next transition */
+    /* calculates the next transition */
+    while (p->trans->nxt == ((p == prod->prv) ? upto : (ATrans *)0))
       p = p->nxt;
     if (p == prod)
       break;
@@ -498,50 +1150,294 @@ void make_gtrans(GState *s) { /* creates all the transitions from a state */
     }
   }
 
-  tfree(list); /* free memory */
+  free_set(fin, 0); /* free memory */
   while (prod->nxt != prod) {
     AProd *p = prod->nxt;
     prod->nxt = p->nxt;
     free_atrans(p->prod, 0);
-    tfree(p);
+    slab_free(p, sizeof(AProd));
   }
   free_atrans(prod->prod, 0);
-  tfree(prod);
+  slab_free(prod, sizeof(AProd));
+  if (tl_simp_fly)
+    free_strie(index);
+  return result;
+}
+
+void *explore_range_thread(void *arg) {
+  GRange *r = (GRange *)arg;
+  init_explore();
+  r->result = explore_range(r->nodes_set, r->from, r->upto);
+  free_explore();
+  return arg;
+}
+
+GProd *merge_ranges(GRange *range, int n) /* concatenates the transitions of
+                                             the ranges; a transition may be
+                                             redondant with one of another
+                                             range, so the subsumption is
+                                             replayed in order */
+{
+  int i, k;
+  GProd *r, *nxt, *result = (GProd *)0, **last = &result;
+  STrie *f, *nf, *index = new_strie();
+  for (i = 0; i < n; i++)
+    for (r = range[i].result; r; r = nxt) {
+      nxt = r->nxt;
+      r->nxt = (GProd *)0;
+      k = gtrans_key(gkey, r->to, r->pos, r->neg, r->final);
+      for (f = strie_supersets(index, gkey, k); f; f = nf) {
+        nf = f->found;
+        ((GProd *)f->item)->alive = 0;
+        strie_remove(f);
+      }
+      if (strie_subset(index, gkey, k)) {
+        free_gprod(r);
+        continue;
+      }
+      r->alive = 1;
+      *last = r;
+      last = &r->nxt;
+      strie_insert(index, gkey, k, r);
+    }
+  free_strie(index);
+  return result;
+}
+
+GProd *explore_nodes(uint64_t *nodes_set) { /* computes the transitions
+                                               from a set of nodes, splitting
+                                               the product between several
+                                               threads when it is large */
+  int i, j, n, k = 0, size = 1, first;
+  SetIter it;
+  ATrans *t;
+  GRange *range;
+  GProd *result, **last;
+
+  first_elem(&it, nodes_set, 0);
+  first = next_elem(&it);
+  for (i = first; i != -1 && size < SPLIT_SIZE; i = next_elem(&it)) {
+    for (n = 0, t = transition[i]; t; t = t->nxt)
+      n++;
+    if (i == first)
+      k = n; /* transitions of the first node */
+    size *= n;
+  }
+  n = (k < tl_threads) ? k : tl_threads;
+  if (n < 2 || size < SPLIT_SIZE)
+    return explore_range(nodes_set,
+                         (first != -1) ? transition[first] : (ATrans *)0,
+                         (ATrans *)0);
+
+  /* n ranges of the transitions of the first node, the first one being
+     computed by the current thread */
+  range = (GRange *)tl_emalloc(n * sizeof(GRange));
+  for (i = 0, t = transition[first]; i < n; i++) {
+    range[i].nodes_set = nodes_set;
+    range[i].from = t;
+    for (j = k / n + (i < k % n); j; j--)
+      t = t->nxt;
+    range[i].upto = t;
+    if (i && pthread_create(&range[i].thread, 0, explore_range_thread,
+                            &range[i]))
+      Fatal("cannot create a thread");
+  }
+  range[0].result = explore_range(nodes_set, range[0].from, range[0].upto);
+  for (i = 1; i < n; i++)
+    pthread_join(range[i].thread, 0);
+
+  if (tl_simp_fly)
+    result = merge_ranges(range, n);
+  else
+    for (i = 0, result = (GProd *)0, last = &result; i < n; i++) {
+      *last = range[i].result;
+      while (*last)
+        last = &(*last)->nxt;
+    }
+  tfree(range);
+  return result;
+}
+
+GProd *explore_gstate(GState *s) { /* computes the transitions from a state */
+  GProd *result;
+  uint64_t *set = new_set(0);
+  unpack_set(s->nodes_set, set, 0);
+  result = explore_nodes(set);
+  free_set(set, 0);
+  return result;
+}
+
+void *explore_worker(void *arg) { /* explores the states of the work stack */
+  GEntry *e;
+  GProd *r;
+  init_explore();
+  pthread_mutex_lock(&work_lock);
+  while (!work_stop) {
+    if (!work_top) {
+      pthread_cond_wait(&work_todo, &work_lock);
+      continue;
+    }
+    e = work_stack[--work_top];
+    if (e->work != W_QUEUED) /* taken back by the main thread */
+      continue;
+    e->work = W_RUNNING;
+    pthread_mutex_unlock(&work_lock);
+    r = explore_gstate(e->gstate);
+    pthread_mutex_lock(&work_lock);
+    e->prod = r;
+    e->work = W_DONE;
+    pthread_cond_broadcast(&work_done);
+  }
+  pthread_mutex_unlock(&work_lock);
+  free_explore();
+  return arg;
+}
+
+GProd *take_gprod(GEntry *e) /* takes the exploration of a state back from
+                                the workers, (0 if not done) */
+{
+  GProd *r = (GProd *)0;
+  if (!workers)
+    return r;
+  pthread_mutex_lock(&work_lock);
+  while (e->work == W_RUNNING)
+    pthread_cond_wait(&work_done, &work_lock);
+  if (e->work == W_DONE)
+    r = e->prod;
+  else
+    e->work = W_IDLE;
+  pthread_mutex_unlock(&work_lock);
+  return r;
+}
+
+void queue_created() /* gives the states created and still reachable to the
+                        workers, the newest on top as in 'gstack' */
+{
+  GEntry *e, *rev = (GEntry *)0;
+  while ((e = gcreated)) {
+    gcreated = e->created;
+    e->created = rev;
+    rev = e;
+  }
+  if (!workers)
+    return;
+  pthread_mutex_lock(&work_lock);
+  for (e = rev; e; e = e->created)
+    if (e->gstate->incoming) {
+      if (work_top == work_size) {
+        GEntry **tmp = (GEntry **)tl_emalloc(2 * work_size * sizeof(GEntry *));
+        memcpy(tmp, work_stack, work_size * sizeof(GEntry *));
+        tfree(work_stack);
+        work_stack = tmp;
+        work_size *= 2;
+      }
+      e->work = W_QUEUED;
+      work_stack[work_top++] = e;
+    }
+  pthread_cond_broadcast(&work_todo);
+  pthread_mutex_unlock(&work_lock);
+}
+
+void start_workers() {
+  int i;
+  GState *s;
+  GEntry **last;
+  work_size = 256;
+  work_top = work_stop = 0;
+  work_stack = (GEntry **)tl_emalloc(work_size * sizeof(GEntry *));
+  workers = (pthread_t *)tl_emalloc((tl_threads - 1) * sizeof(pthread_t));
+  for (s = gstack->nxt, last = &gcreated; s != gstack; s = s->nxt) {
+    *last = gstate_entry(s); /* initial states, the newest first */
+    last = &(*last)->created;
+  }
+  *last = (GEntry *)0;
+  queue_created();
+  for (i = 0; i < tl_threads - 1; i++)
+    if (pthread_create(&workers[i], 0, explore_worker, 0))
+      Fatal("cannot create a thread");
+}
+
+void stop_workers() {
+  int i;
+  pthread_mutex_lock(&work_lock);
+  work_stop = 1;
+  pthread_cond_broadcast(&work_todo);
+  pthread_mutex_unlock(&work_lock);
+  for (i = 0; i < tl_threads - 1; i++)
+    pthread_join(workers[i], 0);
+  tfree(workers);
+  tfree(work_stack);
+  workers = (pthread_t *)0;
+}
+
+void make_gtrans(GState *s) { /* creates all the transitions from a state */
+  int state_trans = 0;
+  GEntry *e = gstate_entry(s), *f;
+  GProd *r, *prod = take_gprod(e);
+  GState *to;
+
+  if (e->work != W_DONE)
+    prod = explore_gstate(s);
+  e->work = W_IDLE;
+  e->prod = (GProd *)0;
+  move_gstate(e, IN_NONE);
+
+  /* looks the targets up in the order of the sequential construction,
+     so that the states are numbered the same way */
+  for (r = prod; r; r = r->nxt) {
+    to = find_gstate(r->to, s);
+    if (r->alive) {
+      GTrans *trans = emalloc_gtrans();
+      trans->to = to;
+      trans->to->incoming++;
+      trans->label = intern_label(r->pos);
+      trans->pos = label_set(trans->label);
+      trans->neg = trans->pos + sym_size;
+      if (final_mask)
+        trans->accept = set_to_mask(r->final);
+      else
+        copy_set(r->final, trans->final, 0);
+      trans->nxt = s->trans->nxt;
+      s->trans->nxt = trans;
+      state_trans++;
+    }
+  }
+  free_gprod(prod);
+  queue_created();
 
   if (tl_simp_fly) {
+    unsigned long h;
     if (s->trans == s->trans->nxt) { /* s has no transitions */
       free_gtrans(s->trans->nxt, s->trans, 1);
       s->trans = (GTrans *)0;
       s->prv = (GState *)0;
       s->nxt = gremoved->nxt;
       gremoved->nxt = s;
-      for (s1 = gremoved->nxt; s1 != gremoved; s1 = s1->nxt)
-        if (s1->prv == s)
-          s1->prv = (GState *)0;
+      move_gstate(e, IN_REMOVED);
       return;
     }
 
-    gstates->trans = s->trans;
-    s1 = gstates->nxt;
-    while (!all_gtrans_match(s, s1, 0))
-      s1 = s1->nxt;
-    if (s1 != gstates) { /* s and s1 are equivalent */
+    h = gstate_signature(s);
+    for (f = gsigs.bucket[h & (gsigs.size - 1)]; f; f = f->nxt)
+      if (f->hash == h && all_gtrans_match(s, f->gstate, 0))
+        break;
+    if (f) { /* s and f->gstate are equivalent */
       free_gtrans(s->trans->nxt, s->trans, 1);
       s->trans = (GTrans *)0;
-      s->prv = s1;
+      s->prv = f->gstate;
       s->nxt = gremoved->nxt;
       gremoved->nxt = s;
-      for (s1 = gremoved->nxt; s1 != gremoved; s1 = s1->nxt)
-        if (s1->prv == s)
-          s1->prv = s->prv;
+      move_gstate(e, IN_REMOVED);
       return;
     }
+    gtable_add(&gsigs, s, h);
   }
 
   s->nxt = gstates->nxt; /* adds the current state to 'gstates' */
   s->prv = gstates;
   s->nxt->prv = s;
   gstates->nxt = s;
+  move_gstate(e, IN_STATES);
   gtrans_count += state_trans;
   gstate_count++;
 }
@@ -554,13 +1450,17 @@ void reverse_print_generalized(
     GState *s) /* dumps the generalized Buchi automaton */
 {
   GTrans *t;
+  uint64_t *set;
   if (s == gstates)
     return;
 
   reverse_print_generalized(s->nxt); /* begins with the last state */
 
   fprintf(tl_out, "state %i (", s->id);
-  print_set(s->nodes_set, 0);
+  set = new_set(0);
+  unpack_set(s->nodes_set, set, 0);
+  print_set(set, 0);
+  free_set(set, 0);
   fprintf(tl_out, ") : %i\n", s->incoming);
   for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
     if (empty_set(t->pos, 1) && empty_set(t->neg, 1))
@@ -570,7 +1470,7 @@ void reverse_print_generalized(
       fprintf(tl_out, " & ");
     print_set(t->neg, 1);
     fprintf(tl_out, " -> %i : ", t->to->id);
-    print_set(t->final, 0);
+    print_final(t);
     fprintf(tl_out, "\n");
   }
 }
@@ -584,6 +1484,116 @@ void print_generalized() { /* prints intial states and calls 'reverse_print' */
   reverse_print_generalized(gstates->nxt);
 }
 
+int in_final(GTrans *t, int i) /* t meets the acceptance condition i */
+{
+  if (final_mask)
+    return (t->accept >> i) & 1;
+  return in_set(t->final, final[i + 1]) != 0;
+}
+
+void dump_generalized_to_json() { /* writes the automaton to tgba.json */
+  int i;
+  GState *s;
+  GTrans *t;
+  cJSON *root = cJSON_CreateObject();
+  cJSON *initial = cJSON_CreateArray();
+  cJSON *states = cJSON_CreateArray();
+  cJSON *transitions = cJSON_CreateArray();
+
+  for (i = 0; i < init_size; i++)
+    if (init[i])
+      cJSON_AddItemToArray(initial, cJSON_CreateNumber(init[i]->id));
+
+  for (s = gstates->prv; s != gstates; s = s->prv) {
+    cJSON *state = cJSON_CreateObject();
+    cJSON_AddNumberToObject(state, "id", s->id);
+    cJSON_AddItemToArray(states, state);
+
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      cJSON *transition = cJSON_CreateObject();
+      cJSON *acceptance = cJSON_CreateArray();
+      cJSON_AddNumberToObject(transition, "from", s->id);
+      cJSON_AddNumberToObject(transition, "to", t->to->id);
+      cJSON_AddItemToObject(transition, "conditions",
+                            conditions_to_json_array(t->pos, t->neg));
+      for (i = 0; i < final[0] - 1; i++)
+        if (in_final(t, i))
+          cJSON_AddItemToArray(acceptance, cJSON_CreateNumber(i));
+      cJSON_AddItemToObject(transition, "acceptance", acceptance);
+      cJSON_AddItemToArray(transitions, transition);
+    }
+  }
+
+  cJSON_AddNumberToObject(root, "acceptance_sets", final[0] - 1);
+  cJSON_AddItemToObject(root, "initial", initial);
+  cJSON_AddItemToObject(root, "states", states);
+  cJSON_AddItemToObject(root, "transitions", transitions);
+
+  char *json_output = cJSON_Print(root);
+  FILE *file = fopen("./tgba.json", "w");
+  if (file) {
+    fprintf(file, "%s", json_output);
+    fclose(file);
+  }
+
+  cJSON_Delete(root);
+  free(json_output);
+}
+
+void print_hoa_generalized() { /* prints the automaton in the HOA format,
+                                  with states numbered from 0 */
+  int i, j, n = 0, start, *number;
+  GState *s;
+  GTrans *t;
+
+  number = (int *)tl_emalloc(gstate_id * sizeof(int));
+  for (s = gstates->prv; s != gstates; s = s->prv)
+    number[s->id] = n++;
+
+  fprintf(tl_out, "HOA: v1\n");
+  fprintf(tl_out, "States: %i\n", n);
+  for (i = 0; i < init_size; i++) { /* an initial state may appear twice */
+    for (j = 0; j < i && init[j] != init[i]; j++)
+      ;
+    if (init[i] && j == i)
+      fprintf(tl_out, "Start: %i\n", number[init[i]->id]);
+  }
+  fprintf(tl_out, "AP: %i", sym_id);
+  for (i = 0; i < sym_id; i++)
+    fprintf(tl_out, " \"%s\"", sym_table[i]);
+  fprintf(tl_out, "\nacc-name: generalized-Buchi %i\n", final[0] - 1);
+  fprintf(tl_out, "Acceptance: %i", final[0] - 1);
+  if (final[0] == 1)
+    fprintf(tl_out, " t");
+  for (i = 0; i < final[0] - 1; i++)
+    fprintf(tl_out, "%sInf(%i)", i ? "&" : " ", i);
+  fprintf(tl_out, "\nproperties: trans-labels explicit-labels trans-acc\n");
+  fprintf(tl_out, "--BODY--\n");
+
+  for (s = gstates->prv; s != gstates; s = s->prv) {
+    fprintf(tl_out, "State: %i\n", number[s->id]);
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      fprintf(tl_out, "[");
+      start = 1;
+      for (i = 0; i < sym_id; i++)
+        if (in_set(t->pos, i) || in_set(t->neg, i)) {
+          fprintf(tl_out, "%s%s%i", start ? "" : "&",
+                  in_set(t->neg, i) ? "!" : "", i);
+          start = 0;
+        }
+      fprintf(tl_out, "%s] %i", start ? "t" : "", number[t->to->id]);
+      for (start = 1, i = 0; i < final[0] - 1; i++)
+        if (in_final(t, i)) {
+          fprintf(tl_out, "%s%i", start ? " {" : " ", i);
+          start = 0;
+        }
+      fprintf(tl_out, "%s\n", start ? "" : "}");
+    }
+  }
+  fprintf(tl_out, "--END--\n");
+  tfree(number);
+}
+
 /********************************************************************\
 |*                       Main method                                *|
 \********************************************************************/
@@ -591,33 +1601,41 @@ void print_generalized() { /* prints intial states and calls 'reverse_print' */
 void mk_generalized() { /* generates a generalized Buchi automaton from the
                            alternating automaton */
   ATrans *t;
+  GTrans *t2;
   GState *s;
 
   if (tl_stats)
     getrusage(RUSAGE_SELF, &tr_debut);
 
-  fin = new_set(0);
   bad_scc = 0; /* will be initialized in simplify_gscc */
   final = list_set(final_set, 0);
+  final_mask = (final[0] - 1 <= 64);
+  all_finals = final_mask && final[0] > 1
+                   ? ~(uint64_t)0 >> (65 - final[0])
+                   : 0;
 
-  gstack = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
+  gstack = (GState *)slab_alloc(sizeof(GState)); /* sentinel */
   gstack->nxt = gstack;
-  gremoved = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
+  gremoved = (GState *)slab_alloc(sizeof(GState)); /* sentinel */
   gremoved->nxt = gremoved;
-  gstates = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
+  gstates = (GState *)slab_alloc(sizeof(GState)); /* sentinel */
   gstates->nxt = gstates;
   gstates->prv = gstates;
+  gtable_init(&gindex);
+  gtable_init(&gsigs);
 
   for (t = transition[0]; t;
        t = t->nxt) { /* puts initial states in the stack */
-    s = (GState *)tl_emalloc(sizeof(GState));
+    s = (GState *)slab_alloc(sizeof(GState));
     s->id = (empty_set(t->to, 0)) ? 0 : gstate_id++;
     s->incoming = 1;
-    s->nodes_set = dup_set(t->to, 0);
+    s->nodes_set = pack_set(t->to, 0);
+    s->hash = hash_set(t->to, 0);
     s->trans = emalloc_gtrans(); /* sentinel */
     s->trans->nxt = s->trans;
     s->nxt = gstack->nxt;
     gstack->nxt = s;
+    move_gstate(gtable_add(&gindex, s, s->hash), IN_STACK);
     init_size++;
   }
 
@@ -627,17 +1645,31 @@ void mk_generalized() { /* generates a generalized Buchi automaton from the
   for (s = gstack->nxt; s != gstack; s = s->nxt)
     init[init_size++] = s;
 
+  make_exit_trans();
+  init_explore();
+  if (tl_threads > 1)
+    start_workers();
+
   while (gstack->nxt !=
          gstack) { /* solves all states in the stack until it is empty */
     s = gstack->nxt;
     gstack->nxt = gstack->nxt->nxt;
     if (!s->incoming) {
+      GEntry *e = gstate_entry(s);
+      free_gprod(take_gprod(e));
+      gtable_remove(&gindex, e);
       free_gstate(s);
       continue;
     }
     make_gtrans(s);
   }
 
+  if (workers)
+    stop_workers();
+  free_explore();
+  free_exit_trans();
+  gtable_free(&gindex);
+  gtable_free(&gsigs);
   retarget_all_gtrans();
 
   if (tl_stats) {
@@ -649,7 +1681,7 @@ void mk_generalized() { /* generates a generalized Buchi automaton from the
             gtrans_count);
   }
 
-  tfree(gstack);
+  slab_free(gstack, sizeof(GState));
   /*for(i = 0; i < node_id; i++) // frees the data from the alternating
    * automaton */
   /*free_atrans(transition[i], 1);*/
@@ -662,18 +1694,39 @@ void mk_generalized() { /* generates a generalized Buchi automaton from the
   }
 
   if (tl_simp_diff) {
-    if (tl_simp_scc)
-      simplify_gscc();
-    simplify_gtrans();
-    if (tl_simp_scc)
-      simplify_gscc();
-    while (simplify_gstates()) { /* simplifies as much as possible */
+    for (s = gstates->nxt; s != gstates; s = s->nxt) {
+      touch_gstate(s); /* every state is to be simplified */
+      for (t2 = s->trans->nxt; t2 != s->trans; t2 = t2->nxt)
+        add_gpred(t2->to, s);
+    }
+    do {
       if (tl_simp_scc)
         simplify_gscc();
       simplify_gtrans();
       if (tl_simp_scc)
         simplify_gscc();
+      while (simplify_gstates()) { /* simplifies as much as possible */
+        if (tl_simp_scc)
+          simplify_gscc();
+        simplify_gtrans();
+        if (tl_simp_scc)
+          simplify_gscc();
+      }
+    } while (tl_simp_scc && simplify_gfinal());
+
+    if (sig_buf) {
+      tfree(sig_buf);
+      sig_buf = (unsigned long *)0;
+      sig_size = 0;
+    }
+    if (gwork) {
+      tfree(gwork);
+      gwork = (GState **)0;
+      gwork_size = gwork_count = 0;
     }
+    for (s = gstates->nxt; s != gstates; s = s->nxt)
+      free_gpred(s);
+    free_gremoved();
 
     if (tl_verbose) {
       fprintf(tl_out, "\nGeneralized Buchi automaton after simplification\n");
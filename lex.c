@@ -194,7 +194,7 @@ Symbol *tl_lookup(char *s) {
     if (strcmp(sp->name, s) == 0)
       return sp;
 
-  sp = (Symbol *)tl_emalloc(sizeof(Symbol));
+  sp = (Symbol *)slab_alloc(sizeof(Symbol));
   sp->name = (char *)tl_emalloc(strlen(s) + 1);
   strcpy(sp->name, s);
   sp->next = symtab[h];
@@ -204,7 +204,7 @@ Symbol *tl_lookup(char *s) {
 }
 
 Symbol *getsym(Symbol *s) {
-  Symbol *n = (Symbol *)tl_emalloc(sizeof(Symbol));
+  Symbol *n = (Symbol *)slab_alloc(sizeof(Symbol));
 
   n->name = s->name;
   return n;
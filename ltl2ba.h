@@ -30,6 +30,7 @@
 /* Some of the code in this file was taken from the Spin software         */
 /* Written by Gerard J. Holzmann, Bell Laboratories, U.S.A.               */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -72,10 +73,29 @@ typedef struct Mapping {
   struct Mapping *nxt;
 } Mapping;
 
+/* sets of 0: nodes, 1: symbols, 2: sccs; the sets of a transition label
+   are allocated in one block, which can be used as a set of type LABEL
+   (pos|neg) or LABEL_NODES (pos|neg|to) */
+#define LABEL 3
+#define LABEL_NODES 4
+
+typedef struct SetIter { /* the elements of a set, see first_elem */
+  uint64_t *set;
+  uint64_t word; /* the elements of set[i] not visited yet */
+  int i;
+  int size;
+} SetIter;
+
+typedef struct ArenaMark { /* see arena_mark */
+  void *chunk;
+  long used;
+  long stamp;
+} ArenaMark;
+
 typedef struct ATrans {
-  int *to;
-  int *pos;
-  int *neg;
+  uint64_t *to;
+  uint64_t *pos;
+  uint64_t *neg;
   struct ATrans *nxt;
 } ATrans;
 
@@ -88,26 +108,38 @@ typedef struct AProd {
 } AProd;
 
 typedef struct GTrans {
-  int *pos;
-  int *neg;
+  uint64_t *pos; /* in the sets of the label, shared with other transitions */
+  uint64_t *neg;
+  int label; /* id of the label, see intern_label */
   struct GState *to;
-  int *final;
+  uint64_t *final; /* acceptance nodes, if there are more than 64 */
+  uint64_t accept; /* otherwise, acceptance conditions by index */
   struct GTrans *nxt;
 } GTrans;
 
 typedef struct GState {
   int id;
   int incoming;
-  int *nodes_set;
+  uint64_t *nodes_set; /* packed, see pack_set */
+  unsigned long hash;  /* hash of nodes_set */
   struct GTrans *trans;
   struct GState *nxt;
   struct GState *prv;
+  int dirty;           /* last simplification pass that changed the state */
+  unsigned long sig;   /* signature of the transitions */
+  struct GPred *pred;  /* states that may have a transition to this one */
 } GState;
 
+typedef struct GPred {
+  struct GState *gstate;
+  struct GPred *nxt;
+} GPred;
+
 typedef struct BTrans {
   struct BState *to;
-  int *pos;
-  int *neg;
+  uint64_t *pos; /* in the sets of the label, shared with other transitions */
+  uint64_t *neg;
+  int label; /* id of the label, see intern_label */
   struct BTrans *nxt;
 } BTrans;
 
@@ -119,22 +151,40 @@ typedef struct BState {
   struct BTrans *trans;
   struct BState *nxt;
   struct BState *prv;
+  int dirty;           /* last simplification pass that changed the state */
+  unsigned long sig;   /* signature of the transitions */
+  struct BPred *pred;  /* states that may have a transition to this one */
+  struct BState *hnxt; /* next state in the same bucket, see find_bstate */
 } BState;
 
+typedef struct BPred {
+  struct BState *bstate;
+  struct BPred *nxt;
+} BPred;
+
 typedef struct GScc {
   struct GState *gstate;
+  struct GTrans *trans; /* next transition to explore */
   int rank;
   int theta;
-  struct GScc *nxt;
 } GScc;
 
 typedef struct BScc {
   struct BState *bstate;
+  struct BTrans *trans; /* next transition to explore */
   int rank;
   int theta;
-  struct BScc *nxt;
 } BScc;
 
+typedef struct STrie {
+  int elem;
+  void *item;
+  struct STrie *child;
+  struct STrie *sibling;
+  struct STrie *parent;
+  struct STrie *found;
+} STrie;
+
 enum {
   ALWAYS = 257,
   AND,        /* 258 */
@@ -176,6 +226,11 @@ int isequal(Node *, Node *);
 int tl_Getchar(void);
 
 void *tl_emalloc(int);
+ArenaMark arena_mark();
+void arena_release(ArenaMark);
+void arena_reset();
+void *slab_alloc(int);
+void slab_free(void *, int);
 ATrans *emalloc_atrans();
 void free_atrans(ATrans *, int);
 void free_all_atrans();
@@ -200,33 +255,62 @@ void trans(Node *);
 
 void mk_alternating(Node *);
 void mk_generalized();
+void dump_generalized_to_json();
+void print_hoa_generalized();
 void mk_buchi();
 
 ATrans *dup_trans(ATrans *);
 ATrans *merge_trans(ATrans *, ATrans *);
 void do_merge_trans(ATrans **, ATrans *, ATrans *);
 
-int *new_set(int);
-int *clear_set(int *, int);
-int *make_set(int, int);
-void copy_set(int *, int *, int);
-int *dup_set(int *, int);
-void merge_sets(int *, int *, int);
-void do_merge_sets(int *, int *, int *, int);
-int *intersect_sets(int *, int *, int);
-void add_set(int *, int);
-void rem_set(int *, int);
-void spin_print_set(int *, int *);
-void spin_sprint_set(char *, int *,int *);
-cJSON *conditions_to_json_array(int *pos, int *neg);
+uint64_t *new_set(int);
+void free_set(uint64_t *, int);
+uint64_t *clear_set(uint64_t *, int);
+uint64_t *make_set(int, int);
+void copy_set(uint64_t *, uint64_t *, int);
+uint64_t *dup_set(uint64_t *, int);
+void merge_sets(uint64_t *, uint64_t *, int);
+void do_merge_sets(uint64_t *, uint64_t *, uint64_t *, int);
+void do_diff_sets(uint64_t *, uint64_t *, uint64_t *, int);
+uint64_t *intersect_sets(uint64_t *, uint64_t *, int);
+void add_set(uint64_t *, int);
+void rem_set(uint64_t *, int);
+void spin_print_set(uint64_t *, uint64_t *);
+void spin_sprint_set(char *, uint64_t *, uint64_t *);
+cJSON *conditions_to_json_array(uint64_t *pos, uint64_t *neg);
 void get_state_name(char *buffer, BState *s);
-void print_set(int *, int);
-int empty_set(int *, int);
-int empty_intersect_sets(int *, int *, int);
-int same_sets(int *, int *, int);
-int included_set(int *, int *, int);
-int in_set(int *, int);
-int *list_set(int *, int);
+void print_set(uint64_t *, int);
+int empty_set(uint64_t *, int);
+int empty_intersect_sets(uint64_t *, uint64_t *, int);
+int same_sets(uint64_t *, uint64_t *, int);
+int included_set(uint64_t *, uint64_t *, int);
+int in_set(uint64_t *, int);
+unsigned long hash_set(uint64_t *, int);
+int *list_set(uint64_t *, int);
+int fill_list(uint64_t *, int, int *, int);
+void first_elem(SetIter *, uint64_t *, int);
+int next_elem(SetIter *);
+int count_set(uint64_t *, int);
+uint64_t *pack_set(uint64_t *, int);
+void free_packed(uint64_t *, int);
+void unpack_set(uint64_t *, uint64_t *, int);
+int same_packed(uint64_t *, uint64_t *, int, int);
+unsigned long hash_label(uint64_t *);
+int intern_label(uint64_t *);
+uint64_t *label_set(int);
+unsigned long label_hash(int);
+int included_label(int, int);
+void init_set_kernel();
+const char *use_set_kernel(int);
+void init_set_ops(int);
+void use_set_widths(int);
+
+STrie *new_strie();
+void free_strie(STrie *);
+STrie *strie_insert(STrie *, int *, int, void *);
+void strie_remove(STrie *);
+void *strie_subset(STrie *, int *, int);
+STrie *strie_supersets(STrie *, int *, int);
 
 int timeval_subtract(struct timeval *, struct timeval *, struct timeval *);
 
@@ -41,10 +41,15 @@ int tl_simp_diff = 1; /* automata simplification */
 int tl_simp_fly = 1;  /* on the fly simplification */
 int tl_simp_scc = 1;  /* use scc simplification */
 int tl_fjtofj = 1;    /* 2eme fj */
+int tl_threads = 1;   /* threads building the generalized automaton */
+int tl_degen_scc = 0; /* degeneralization counter local to each scc */
+int tl_tgba = 0;      /* output the generalized automaton */
+int tl_simp_sim = 0;  /* direct simulation on the Buchi automaton */
 int tl_errs = 0;
 int tl_verbose = 0;
 int tl_terse = 0;
-unsigned long All_Mem = 0;
+unsigned long All_Mem = 0;  /* memory of the arena, see mem.c */
+unsigned long Peak_Mem = 0; /* the most it has been */
 
 static char uform[4096];
 static int hasuform = 0, cnt = 0;
@@ -115,6 +120,10 @@ static void usage(void) {
   printf(" -o\t\tdisable (O)n-the-fly simplification\n");
   printf(" -c\t\tdisable strongly (C)onnected components simplification\n");
   printf(" -a\t\tdisable trick in (A)ccepting conditions\n");
+  printf(" -g\t\tuse SCC-local de(G)eneralization\n");
+  printf(" -m\t\tmerge states by direct si(M)ulation in the Buchi automaton\n");
+  printf(" -t\t\toutput the (T)ransition-based generalized automaton\n");
+  printf(" -j<n>\t\tuse n threads to build the generalized automaton\n");
 
   alldone(1);
 }
@@ -144,12 +153,14 @@ int tl_main(int argc, char *argv[]) {
   tl_parse();
   if (tl_stats)
     tl_endstats();
+  arena_reset();
   return tl_errs;
 }
 
 int main(int argc, char *argv[]) {
   int i;
   tl_out = stdout;
+  init_set_kernel();
 
   while (argc > 1 && argv[1][0] == '-') {
     switch (argv[1][1]) {
@@ -184,6 +195,20 @@ int main(int argc, char *argv[]) {
     case 's':
       tl_stats = 1;
       break;
+    case 'g':
+      tl_degen_scc = 1;
+      break;
+    case 'm':
+      tl_simp_sim = 1;
+      break;
+    case 't':
+      tl_tgba = 1;
+      break;
+    case 'j':
+      tl_threads = atoi(argv[1] + 2);
+      if (tl_threads < 1)
+        tl_threads = 1;
+      break;
     default:
       usage();
       break;
@@ -243,7 +268,8 @@ struct timeval *result, *x, *y;
 }
 
 static void tl_endstats(void) { /*extern int Stack_mx;*/
-  printf("\ntotal memory used: %9ld\n", All_Mem);
+  printf("\ntotal memory used: %9ld\n", Peak_Mem);
+  printf("memory in use:     %9ld\n", All_Mem);
   /*printf("largest stack sze: %9d\n", Stack_mx);*/
   /*cache_stats();*/
   a_stats();
@@ -31,28 +31,44 @@
 /* Written by Gerard J. Holzmann, Bell Laboratories, U.S.A.               */
 
 #include "ltl2ba.h"
+#include <pthread.h>
 
 #if 1
-#define log(e, u, d) event[e][(int)u] += (long)d;
+#define log(e, u, d) __atomic_add_fetch(&event[e][(int)u], (long)d, __ATOMIC_RELAXED);
+#define slog(e, w, d) __atomic_add_fetch(&sevent[e][(int)w], (long)d, __ATOMIC_RELAXED);
 #else
 #define log(e, u, d)
+#define slog(e, w, d)
 #endif
 
 #define A_LARGE 80
 #define A_USER 0x55000000
 #define NOTOOBIG 32768
+#define CHUNK (1L << 20) /* bytes of a chunk of the arena */
+#define S_LARGE 64       /* words of the objects too large for the slabs */
+
+#ifdef SLAB_CHECK /* a tag before each object of the slabs, to catch the
+                     double frees */
+#define S_TAG 1
+#else
+#define S_TAG 0
+#endif
 
 #define POOL 0
 #define ALLOC 1
 #define FREE 2
 #define NREVENT 3
 
-extern unsigned long All_Mem;
-extern int tl_verbose;
+extern unsigned long All_Mem, Peak_Mem;
+extern int tl_verbose, final_mask, sym_size;
 
-ATrans *atrans_list = (ATrans *)0;
-GTrans *gtrans_list = (GTrans *)0;
-BTrans *btrans_list = (BTrans *)0;
+/* the free lists are per thread (see mk_generalized), the counters are
+   shared */
+#define count(c, d) __atomic_add_fetch(&c, d, __ATOMIC_RELAXED)
+
+__thread ATrans *atrans_list = (ATrans *)0;
+__thread GTrans *gtrans_list = (GTrans *)0;
+__thread BTrans *btrans_list = (BTrans *)0;
 
 int aallocs = 0, afrees = 0, apool = 0;
 int gallocs = 0, gfrees = 0, gpool = 0;
@@ -63,10 +79,113 @@ union M {
   union M *link;
 };
 
-static union M *freelist[A_LARGE];
-static long req[A_LARGE];
+static __thread union M *freelist[A_LARGE];
+static __thread long req[A_LARGE];
 static long event[NREVENT][A_LARGE];
 
+/* the slabs hold the small objects whose size is known when they are
+   freed, by number of words, without the header of tl_emalloc */
+
+static __thread uint64_t *slab[S_LARGE]; /* free objects, linked by their
+                                            first word */
+static __thread long sreq[S_LARGE];
+static long sevent[NREVENT][S_LARGE];
+
+#define words(n) ((n) > 0 ? ((n) + sizeof(uint64_t) - 1) / sizeof(uint64_t) : 1)
+
+/* the pools and the large blocks of a translation are cut from the chunks
+   of an arena, which are given back all at once by arena_reset, or from a
+   mark on by arena_release */
+
+typedef struct Chunk {
+  struct Chunk *prv; /* the chunk allocated before */
+  long stamp;        /* rank of the chunk in the arena */
+  long size;         /* bytes after the header */
+  long used;
+} Chunk;
+
+static Chunk *chunks;  /* all the chunks, the newest first */
+static Chunk *current; /* the chunk the blocks are cut from */
+static long stamps;
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static Chunk *new_chunk(long size) /* called with arena_lock held */
+{
+  Chunk *c = (Chunk *)malloc(sizeof(Chunk) + size);
+  if (!c)
+    fatal("not enough memory");
+  c->prv = chunks;
+  c->stamp = ++stamps;
+  c->size = size;
+  c->used = 0;
+  chunks = c;
+  All_Mem += sizeof(Chunk) + size;
+  if (All_Mem > Peak_Mem)
+    Peak_Mem = All_Mem;
+  return c;
+}
+
+static void *arena_alloc(long n) /* n bytes, a multiple of sizeof(union M) */
+{
+  Chunk *c;
+  void *p;
+  pthread_mutex_lock(&arena_lock);
+  if (n > CHUNK / 4) /* a chunk of its own, the current one is kept */
+    c = new_chunk(n);
+  else {
+    if (!current || current->used + n > current->size)
+      current = new_chunk(CHUNK);
+    c = current;
+  }
+  p = (char *)(c + 1) + c->used;
+  c->used += n;
+  pthread_mutex_unlock(&arena_lock);
+  return p;
+}
+
+ArenaMark arena_mark() { /* the state of the arena, see arena_release */
+  ArenaMark m;
+  pthread_mutex_lock(&arena_lock);
+  m.chunk = current;
+  m.used = current ? current->used : 0;
+  m.stamp = stamps;
+  pthread_mutex_unlock(&arena_lock);
+  return m;
+}
+
+void arena_release(ArenaMark m) /* gives back all that was allocated since
+                                   the mark; none of it may be in use, and
+                                   no other thread may be allocating */
+{
+  Chunk *c;
+  pthread_mutex_lock(&arena_lock);
+  while (chunks && chunks->stamp > m.stamp) {
+    c = chunks;
+    chunks = c->prv;
+    All_Mem -= sizeof(Chunk) + c->size;
+    free(c);
+  }
+  current = (Chunk *)m.chunk;
+  if (current)
+    current->used = m.used;
+  pthread_mutex_unlock(&arena_lock);
+
+  /* the free lists may hold blocks cut since the mark: they are dropped,
+     the older blocks with them until the arena is reset */
+  memset(freelist, 0, sizeof(freelist));
+  memset(req, 0, sizeof(req));
+  memset(slab, 0, sizeof(slab));
+  memset(sreq, 0, sizeof(sreq));
+  atrans_list = (ATrans *)0;
+  gtrans_list = (GTrans *)0;
+  btrans_list = (BTrans *)0;
+}
+
+void arena_reset() { /* gives back all the memory of the translation */
+  ArenaMark m = {(void *)0, 0, 0};
+  arena_release(m);
+}
+
 void *tl_emalloc(int U) {
   union M *m;
   long r, u;
@@ -78,16 +197,14 @@ void *tl_emalloc(int U) {
     log(ALLOC, 0, 1);
     if (tl_verbose)
       printf("tl_spin: memalloc %ld bytes\n", u);
-    m = (union M *)emalloc((int)u * sizeof(union M));
-    All_Mem += (unsigned long)u * sizeof(union M);
+    m = (union M *)arena_alloc(u * sizeof(union M));
   } else {
     if (!freelist[u]) {
       r = req[u] += req[u] ? req[u] : 1;
       if (r >= NOTOOBIG)
         r = req[u] = NOTOOBIG;
       log(POOL, u, r);
-      freelist[u] = (union M *)emalloc((int)r * u * sizeof(union M));
-      All_Mem += (unsigned long)r * u * sizeof(union M);
+      freelist[u] = (union M *)arena_alloc(r * u * sizeof(union M));
       m = freelist[u] + (r - 2) * u;
       for (; m >= freelist[u]; m -= u)
         m->link = m + u;
@@ -116,8 +233,7 @@ void tfree(void *v) {
 
   u = (m->size &= 0xFFFFFF);
   if (u >= A_LARGE) {
-    log(FREE, 0, 1);
-    /* free(m); */
+    log(FREE, 0, 1); /* given back with the arena */
   } else {
     log(FREE, u, 1);
     m->link = freelist[u];
@@ -125,20 +241,65 @@ void tfree(void *v) {
   }
 }
 
+void *slab_alloc(int n) /* n bytes from the slab of their size */
+{
+  uint64_t *m;
+  long r, w = words(n);
+
+  if (w >= S_LARGE)
+    return tl_emalloc(n);
+  if (!slab[w]) {
+    r = sreq[w] += sreq[w] ? sreq[w] : 1;
+    if (r >= NOTOOBIG)
+      r = sreq[w] = NOTOOBIG;
+    slog(POOL, w, r);
+    slab[w] = (uint64_t *)arena_alloc(r * (w + S_TAG) * sizeof(uint64_t));
+    for (m = slab[w]; --r; m += w + S_TAG)
+      *(uint64_t **)m = m + w + S_TAG;
+    *(uint64_t **)m = (uint64_t *)0;
+  }
+  slog(ALLOC, w, 1);
+  m = slab[w];
+  slab[w] = *(uint64_t **)m;
+#ifdef SLAB_CHECK
+  *m++ = A_USER | w;
+#endif
+  memset(m, 0, w * sizeof(uint64_t));
+  return (void *)m;
+}
+
+void slab_free(void *v, int n) /* gives back an object of n bytes */
+{
+  uint64_t *m = (uint64_t *)v;
+  long w = words(n);
+
+  if (w >= S_LARGE) {
+    tfree(v);
+    return;
+  }
+#ifdef SLAB_CHECK
+  if (*--m != (A_USER | w))
+    Fatal("releasing a free block");
+#endif
+  slog(FREE, w, 1);
+  *(uint64_t **)m = slab[w];
+  slab[w] = m;
+}
+
 ATrans *emalloc_atrans() {
   ATrans *result;
   if (!atrans_list) {
-    result = (ATrans *)tl_emalloc(sizeof(GTrans));
-    result->pos = new_set(1);
-    result->neg = new_set(1);
-    result->to = new_set(0);
-    apool++;
+    result = (ATrans *)slab_alloc(sizeof(ATrans));
+    result->pos = new_set(LABEL_NODES); /* pos|neg|to */
+    result->neg = result->pos + sym_size;
+    result->to = result->neg + sym_size;
+    count(apool, 1);
   } else {
     result = atrans_list;
     atrans_list = atrans_list->nxt;
     result->nxt = (ATrans *)0;
   }
-  aallocs++;
+  count(aallocs, 1);
   return result;
 }
 
@@ -149,7 +310,7 @@ void free_atrans(ATrans *t, int rec) {
     free_atrans(t->nxt, rec);
   t->nxt = atrans_list;
   atrans_list = t;
-  afrees++;
+  count(afrees, 1);
 }
 
 void free_all_atrans() {
@@ -157,31 +318,27 @@ void free_all_atrans() {
   while (atrans_list) {
     t = atrans_list;
     atrans_list = t->nxt;
-    tfree(t->to);
-    tfree(t->pos);
-    tfree(t->neg);
-    tfree(t);
+    free_set(t->pos, LABEL_NODES);
+    slab_free(t, sizeof(ATrans));
   }
 }
 
 GTrans *emalloc_gtrans() {
   GTrans *result;
   if (!gtrans_list) {
-    result = (GTrans *)tl_emalloc(sizeof(GTrans));
-    result->pos = new_set(1);
-    result->neg = new_set(1);
-    result->final = new_set(0);
-    gpool++;
+    result = (GTrans *)slab_alloc(sizeof(GTrans));
+    result->final = final_mask ? (uint64_t *)0 : new_set(0);
+    count(gpool, 1);
   } else {
     result = gtrans_list;
     gtrans_list = gtrans_list->nxt;
   }
-  gallocs++;
+  count(gallocs, 1);
   return result;
 }
 
 void free_gtrans(GTrans *t, GTrans *sentinel, int fly) {
-  gfrees++;
+  count(gfrees, 1);
   if (sentinel && (t != sentinel)) {
     free_gtrans(t->nxt, sentinel, fly);
     if (fly)
@@ -194,20 +351,18 @@ void free_gtrans(GTrans *t, GTrans *sentinel, int fly) {
 BTrans *emalloc_btrans() {
   BTrans *result;
   if (!btrans_list) {
-    result = (BTrans *)tl_emalloc(sizeof(BTrans));
-    result->pos = new_set(1);
-    result->neg = new_set(1);
-    bpool++;
+    result = (BTrans *)slab_alloc(sizeof(BTrans));
+    count(bpool, 1);
   } else {
     result = btrans_list;
     btrans_list = btrans_list->nxt;
   }
-  ballocs++;
+  count(ballocs, 1);
   return result;
 }
 
 void free_btrans(BTrans *t, BTrans *sentinel, int fly) {
-  bfrees++;
+  count(bfrees, 1);
   if (sentinel && (t != sentinel)) {
     free_btrans(t->nxt, sentinel, fly);
     if (fly)
@@ -232,6 +387,17 @@ void a_stats(void) {
       printf("%5d\t%6ld\t%6ld\t%6ld\n", i, p, a, f);
   }
 
+  printf("words\t  pool\tallocs\t frees\n");
+
+  for (i = 0; i < S_LARGE; i++) {
+    p = sevent[POOL][i];
+    a = sevent[ALLOC][i];
+    f = sevent[FREE][i];
+
+    if (p | a | f)
+      printf("%5d\t%6ld\t%6ld\t%6ld\n", i, p, a, f);
+  }
+
   printf("atrans\t%6d\t%6d\t%6d\n", apool, aallocs, afrees);
   printf("gtrans\t%6d\t%6d\t%6d\n", gpool, gallocs, gfrees);
   printf("btrans\t%6d\t%6d\t%6d\n", bpool, ballocs, bfrees);
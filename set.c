@@ -34,18 +34,425 @@ extern FILE *tl_out;
 extern int node_size, sym_size, scc_size;
 extern char **sym_table;
 
-int mod = 8 * sizeof(int);
+int mod = 8 * sizeof(uint64_t);
+
+/* type = 2 for scc set, 1 for symbol sets, 0 for nodes sets, LABEL and
+   LABEL_NODES for the labels of the transitions */
+
+#define set_size(t)                                                            \
+  (t == 1 ? sym_size                                                           \
+          : (t == 2 ? scc_size                                                 \
+                    : (t == 0 ? node_size                                      \
+                              : 2 * sym_size + (t == LABEL ? 0 : node_size))))
+#define bit(n) ((uint64_t)1 << ((n) % mod))
+
+/********************************************************************\
+|*        Kernels of the predicates, chosen from the processor      *|
+\********************************************************************/
+
+/* the predicates stop at the first vector where the sets differ; they are
+   only used for the sets whose width has no specialized operations, see
+   init_set_ops */
+
+typedef struct SetKernel {
+  const char *name;
+  int (*included)(uint64_t *, uint64_t *, int);
+  int (*same)(uint64_t *, uint64_t *, int);
+  int (*disjoint)(uint64_t *, uint64_t *, int);
+  int (*empty)(uint64_t *, int);
+  void (*merge)(uint64_t *, uint64_t *, uint64_t *, int);
+} SetKernel;
+
+static int included_scalar(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    if (l1[i] & ~l2[i])
+      return 0;
+  return 1;
+}
+
+static int same_scalar(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    if (l1[i] != l2[i])
+      return 0;
+  return 1;
+}
+
+static int disjoint_scalar(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    if (l1[i] & l2[i])
+      return 0;
+  return 1;
+}
+
+static int empty_scalar(uint64_t *l, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    if (l[i])
+      return 0;
+  return 1;
+}
+
+static void merge_scalar(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    l[i] = l1[i] | l2[i];
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SET_SIMD
+
+/* SSE2: two words per vector, a vector is zero if all its bytes are */
+
+#define zero128(v)                                                             \
+  (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xffff)
+#define load128(l, i) _mm_loadu_si128((__m128i *)((l) + (i)))
+
+__attribute__((target("sse2"))) static int
+included_sse2(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 2 <= n; i += 2)
+    if (!zero128(_mm_andnot_si128(load128(l2, i), load128(l1, i))))
+      return 0;
+  return included_scalar(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("sse2"))) static int
+same_sse2(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 2 <= n; i += 2)
+    if (!zero128(_mm_xor_si128(load128(l1, i), load128(l2, i))))
+      return 0;
+  return same_scalar(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("sse2"))) static int
+disjoint_sse2(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 2 <= n; i += 2)
+    if (!zero128(_mm_and_si128(load128(l1, i), load128(l2, i))))
+      return 0;
+  return disjoint_scalar(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("sse2"))) static int empty_sse2(uint64_t *l, int n) {
+  int i;
+  for (i = 0; i + 2 <= n; i += 2)
+    if (!zero128(load128(l, i)))
+      return 0;
+  return empty_scalar(l + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void
+merge_sse2(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 2 <= n; i += 2)
+    _mm_storeu_si128((__m128i *)(l + i),
+                     _mm_or_si128(load128(l1, i), load128(l2, i)));
+  merge_scalar(l + i, l1 + i, l2 + i, n - i);
+}
+
+/* AVX2: four words per vector, tested with vptest */
+
+#define load256(l, i) _mm256_loadu_si256((__m256i *)((l) + (i)))
+
+__attribute__((target("avx2"))) static int
+included_avx2(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 4 <= n; i += 4)
+    if (!_mm256_testc_si256(load256(l2, i), load256(l1, i)))
+      return 0;
+  return included_scalar(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("avx2"))) static int
+same_avx2(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  __m256i x;
+  for (i = 0; i + 4 <= n; i += 4) {
+    x = _mm256_xor_si256(load256(l1, i), load256(l2, i));
+    if (!_mm256_testz_si256(x, x))
+      return 0;
+  }
+  return same_scalar(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("avx2"))) static int
+disjoint_avx2(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 4 <= n; i += 4)
+    if (!_mm256_testz_si256(load256(l1, i), load256(l2, i)))
+      return 0;
+  return disjoint_scalar(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("avx2"))) static int empty_avx2(uint64_t *l, int n) {
+  int i;
+  __m256i x;
+  for (i = 0; i + 4 <= n; i += 4) {
+    x = load256(l, i);
+    if (!_mm256_testz_si256(x, x))
+      return 0;
+  }
+  return empty_scalar(l + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void
+merge_avx2(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_si256((__m256i *)(l + i),
+                        _mm256_or_si256(load256(l1, i), load256(l2, i)));
+  merge_scalar(l + i, l1 + i, l2 + i, n - i);
+}
+
+/* AVX-512: eight words per vector, the rest is left to AVX2 (a masked
+   tail is slower on the small sets) */
+
+#define load512(l, i) _mm512_loadu_si512((void *)((l) + (i)))
+
+__attribute__((target("avx512f,avx2"))) static int
+included_avx512(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  __m512i x;
+  for (i = 0; i + 8 <= n; i += 8) {
+    x = _mm512_andnot_si512(load512(l2, i), load512(l1, i));
+    if (_mm512_test_epi64_mask(x, x))
+      return 0;
+  }
+  return included_avx2(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("avx512f,avx2"))) static int
+same_avx512(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 8 <= n; i += 8)
+    if (_mm512_cmpneq_epi64_mask(load512(l1, i), load512(l2, i)))
+      return 0;
+  return same_avx2(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("avx512f,avx2"))) static int
+disjoint_avx512(uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 8 <= n; i += 8)
+    if (_mm512_test_epi64_mask(load512(l1, i), load512(l2, i)))
+      return 0;
+  return disjoint_avx2(l1 + i, l2 + i, n - i);
+}
+
+__attribute__((target("avx512f,avx2"))) static int
+empty_avx512(uint64_t *l, int n) {
+  int i;
+  __m512i x;
+  for (i = 0; i + 8 <= n; i += 8) {
+    x = load512(l, i);
+    if (_mm512_test_epi64_mask(x, x))
+      return 0;
+  }
+  return empty_avx2(l + i, n - i);
+}
+
+__attribute__((target("avx512f,avx2"))) static void
+merge_avx512(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm512_storeu_si512((void *)(l + i),
+                        _mm512_or_si512(load512(l1, i), load512(l2, i)));
+  merge_avx2(l + i, l1 + i, l2 + i, n - i);
+}
+#endif
+
+static SetKernel set_kernels[] = {
+    {"scalar", included_scalar, same_scalar, disjoint_scalar, empty_scalar,
+     merge_scalar},
+#ifdef SET_SIMD
+    {"sse2", included_sse2, same_sse2, disjoint_sse2, empty_sse2, merge_sse2},
+    {"avx2", included_avx2, same_avx2, disjoint_avx2, empty_avx2, merge_avx2},
+    {"avx512", included_avx512, same_avx512, disjoint_avx512, empty_avx512,
+     merge_avx512},
+#endif
+};
+static SetKernel *kernel = set_kernels;
+static int set_widths = 1; /* 0 to use the kernels for all the widths */
+
+static int supported_kernel(int k) /* tests if the processor runs kernel k */
+{
+#ifdef SET_SIMD
+  __builtin_cpu_init();
+  switch (k) {
+  case 1:
+    return __builtin_cpu_supports("sse2");
+  case 2:
+    return __builtin_cpu_supports("avx2");
+  case 3:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f");
+  }
+#endif
+  return k == 0;
+}
+
+const char *use_set_kernel(int k) /* selects kernel k, returns its name or 0
+                                     if the processor does not run it */
+{
+  if (k < 0 || k >= (int)(sizeof(set_kernels) / sizeof(SetKernel)) ||
+      !supported_kernel(k))
+    return (const char *)0;
+  kernel = &set_kernels[k];
+  use_set_widths(set_widths);
+  return kernel->name;
+}
 
-/* type = 2 for scc set, 1 for symbol sets, 0 for nodes sets */
+void init_set_kernel() /* selects the widest kernel of the processor */
+{
+  int k = sizeof(set_kernels) / sizeof(SetKernel) - 1;
+  while (!use_set_kernel(k))
+    k--;
+}
+
+/********************************************************************\
+|*         Operations specialized for the width of the sets         *|
+\********************************************************************/
+
+/* the width of the sets of a type is fixed once the formula is known: the
+   operations of each type are chosen then, so that sets of 1, 2, 3, 4 or 8
+   words run loops of a constant length, which the compiler unrolls (3 words
+   is the label of a transition of the alternating automaton, when the sets
+   have one word) */
+
+typedef struct SetOps {
+  int size;
+  int (*included)(uint64_t *, uint64_t *, int);
+  int (*same)(uint64_t *, uint64_t *, int);
+  int (*disjoint)(uint64_t *, uint64_t *, int);
+  int (*empty)(uint64_t *, int);
+  void (*merge)(uint64_t *, uint64_t *, uint64_t *, int);
+  void (*diff)(uint64_t *, uint64_t *, uint64_t *, int);
+  void (*copy)(uint64_t *, uint64_t *, int);
+} SetOps;
+
+static void diff_any(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    l[i] = l1[i] & ~l2[i];
+}
+
+static void copy_any(uint64_t *from, uint64_t *to, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    to[i] = from[i];
+}
+
+#define SET_WIDTH(w)                                                           \
+  static int included_##w(uint64_t *l1, uint64_t *l2, int n) {                 \
+    int i;                                                                     \
+    uint64_t test = 0;                                                         \
+    for (i = 0; i < w; i++)                                                    \
+      test |= l1[i] & ~l2[i];                                                  \
+    return !test;                                                              \
+  }                                                                            \
+  static int same_##w(uint64_t *l1, uint64_t *l2, int n) {                     \
+    int i;                                                                     \
+    uint64_t test = 0;                                                         \
+    for (i = 0; i < w; i++)                                                    \
+      test |= l1[i] ^ l2[i];                                                   \
+    return !test;                                                              \
+  }                                                                            \
+  static int disjoint_##w(uint64_t *l1, uint64_t *l2, int n) {                 \
+    int i;                                                                     \
+    uint64_t test = 0;                                                         \
+    for (i = 0; i < w; i++)                                                    \
+      test |= l1[i] & l2[i];                                                   \
+    return !test;                                                              \
+  }                                                                            \
+  static int empty_##w(uint64_t *l, int n) {                                   \
+    int i;                                                                     \
+    uint64_t test = 0;                                                         \
+    for (i = 0; i < w; i++)                                                    \
+      test |= l[i];                                                            \
+    return !test;                                                              \
+  }                                                                            \
+  static void merge_##w(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {      \
+    int i;                                                                     \
+    for (i = 0; i < w; i++)                                                    \
+      l[i] = l1[i] | l2[i];                                                    \
+  }                                                                            \
+  static void diff_##w(uint64_t *l, uint64_t *l1, uint64_t *l2, int n) {       \
+    int i;                                                                     \
+    for (i = 0; i < w; i++)                                                    \
+      l[i] = l1[i] & ~l2[i];                                                   \
+  }                                                                            \
+  static void copy_##w(uint64_t *from, uint64_t *to, int n) {                  \
+    int i;                                                                     \
+    for (i = 0; i < w; i++)                                                    \
+      to[i] = from[i];                                                         \
+  }
 
-#define set_size(t) (t == 1 ? sym_size : (t == 2 ? scc_size : node_size))
+SET_WIDTH(1)
+SET_WIDTH(2)
+SET_WIDTH(3)
+SET_WIDTH(4)
+SET_WIDTH(8)
+
+#define WIDTH_OPS(w)                                                           \
+  { w, included_##w, same_##w, disjoint_##w, empty_##w, merge_##w, diff_##w,   \
+    copy_##w }
+
+static SetOps width_ops[] = {WIDTH_OPS(1), WIDTH_OPS(2), WIDTH_OPS(3),
+                             WIDTH_OPS(4), WIDTH_OPS(8)};
+static SetOps set_ops[5]; /* the operations of each type of set */
+
+void init_set_ops(int type) /* chooses the operations on the sets of a type,
+                               once their size is known */
+{
+  int i, n = set_size(type);
+  SetOps *o = &set_ops[type];
+  for (i = 0; set_widths && i < (int)(sizeof(width_ops) / sizeof(SetOps)); i++)
+    if (width_ops[i].size == n) {
+      *o = width_ops[i];
+      return;
+    }
+  o->size = n;
+  o->included = kernel->included;
+  o->same = kernel->same;
+  o->disjoint = kernel->disjoint;
+  o->empty = kernel->empty;
+  o->merge = kernel->merge;
+  o->diff = diff_any;
+  o->copy = copy_any;
+}
+
+void use_set_widths(int on) /* enables or disables the specialized
+                               operations */
+{
+  int type;
+  set_widths = on;
+  for (type = 0; type <= LABEL_NODES; type++)
+    init_set_ops(type);
+}
+
+/* the sets come from the slabs of mem.c, but the scc sets, whose width
+   changes with the sccs between the allocation and the release */
+
+uint64_t *new_set(int type) /* creates a new set */
+{
+  if (type == 2)
+    return (uint64_t *)tl_emalloc(set_size(type) * sizeof(uint64_t));
+  return (uint64_t *)slab_alloc(set_size(type) * sizeof(uint64_t));
+}
 
-int *new_set(int type) /* creates a new set */
+void free_set(uint64_t *l, int type) /* frees a set made by new_set */
 {
-  return (int *)tl_emalloc(set_size(type) * sizeof(int));
+  if (type == 2)
+    tfree(l);
+  else
+    slab_free(l, set_size(type) * sizeof(uint64_t));
 }
 
-int *clear_set(int *l, int type) /* clears the set */
+uint64_t *clear_set(uint64_t *l, int type) /* clears the set */
 {
   int i;
   for (i = 0; i < set_size(type); i++) {
@@ -54,91 +461,116 @@ int *clear_set(int *l, int type) /* clears the set */
   return l;
 }
 
-int *make_set(int n,
-              int type) /* creates the set {n}, or the empty set if n = -1 */
+uint64_t *make_set(int n, int type) /* creates the set {n}, or the empty set
+                                       if n = -1 */
 {
-  int *l = clear_set(new_set(type), type);
+  uint64_t *l = clear_set(new_set(type), type);
   if (n == -1)
     return l;
-  l[n / mod] = 1 << (n % mod);
+  l[n / mod] = bit(n);
   return l;
 }
 
-void copy_set(int *from, int *to, int type) /* copies a set */
+void copy_set(uint64_t *from, uint64_t *to, int type) /* copies a set */
 {
-  int i;
-  for (i = 0; i < set_size(type); i++)
-    to[i] = from[i];
+  set_ops[type].copy(from, to, set_ops[type].size);
 }
 
-int *dup_set(int *l, int type) /* duplicates a set */
+uint64_t *dup_set(uint64_t *l, int type) /* duplicates a set */
 {
-  int i, *m = new_set(type);
-  for (i = 0; i < set_size(type); i++)
-    m[i] = l[i];
+  uint64_t *m = new_set(type);
+  set_ops[type].copy(l, m, set_ops[type].size);
   return m;
 }
 
-void merge_sets(int *l1, int *l2,
+void merge_sets(uint64_t *l1, uint64_t *l2,
                 int type) /* puts the union of the two sets in l1 */
 {
-  int i;
-  for (i = 0; i < set_size(type); i++)
-    l1[i] = l1[i] | l2[i];
+  set_ops[type].merge(l1, l1, l2, set_ops[type].size);
 }
 
-void do_merge_sets(int *l, int *l1, int *l2,
+void do_merge_sets(uint64_t *l, uint64_t *l1, uint64_t *l2,
                    int type) /* makes the union of two sets */
 {
-  int i;
-  for (i = 0; i < set_size(type); i++)
-    l[i] = l1[i] | l2[i];
+  set_ops[type].merge(l, l1, l2, set_ops[type].size);
+}
+
+void do_diff_sets(uint64_t *l, uint64_t *l1, uint64_t *l2,
+                  int type) /* makes the difference of two sets */
+{
+  set_ops[type].diff(l, l1, l2, set_ops[type].size);
 }
 
-int *intersect_sets(int *l1, int *l2,
-                    int type) /* makes the intersection of two sets */
+uint64_t *intersect_sets(uint64_t *l1, uint64_t *l2,
+                         int type) /* makes the intersection of two sets */
 {
-  int i, *l = new_set(type);
+  int i;
+  uint64_t *l = new_set(type);
   for (i = 0; i < set_size(type); i++)
     l[i] = l1[i] & l2[i];
   return l;
 }
 
-int empty_intersect_sets(int *l1, int *l2,
+int empty_intersect_sets(uint64_t *l1, uint64_t *l2,
                          int type) /* tests intersection of two sets */
 {
-  int i, test = 0;
-  for (i = 0; i < set_size(type); i++)
-    test |= l1[i] & l2[i];
-  return !test;
+  return set_ops[type].disjoint(l1, l2, set_ops[type].size);
+}
+
+void add_set(uint64_t *l, int n) /* adds an element to a set */
+{
+  l[n / mod] |= bit(n);
+}
+
+void rem_set(uint64_t *l, int n) /* removes an element from a set */
+{
+  l[n / mod] &= ~bit(n);
 }
 
-void add_set(int *l, int n) /* adds an element to a set */
+/* the elements of a set are visited word by word, each word being consumed
+   from its lowest bit: the cost is the number of words plus the number of
+   elements */
+
+void first_elem(SetIter *it, uint64_t *l,
+                int type) /* starts visiting the elements of a set */
 {
-  l[n / mod] |= 1 << (n % mod);
+  it->set = l;
+  it->size = set_size(type);
+  it->i = 0;
+  it->word = it->size ? l[0] : 0;
 }
 
-void rem_set(int *l, int n) /* removes an element from a set */
+int next_elem(SetIter *it) /* the next element of the set, or -1 */
 {
-  l[n / mod] &= (-1 - (1 << (n % mod)));
+  int n;
+  while (!it->word) {
+    if (++it->i >= it->size)
+      return -1;
+    it->word = it->set[it->i];
+  }
+  n = mod * it->i + __builtin_ctzll(it->word);
+  it->word &= it->word - 1;
+  return n;
 }
 
-void spin_print_set(int *pos,
-                    int *neg) /* prints the content of a set for spin */
+void spin_print_set(uint64_t *pos,
+                    uint64_t *neg) /* prints the content of a set for spin */
 {
-  int i, j, start = 1;
+  int i, n, start = 1;
+  uint64_t w;
   for (i = 0; i < sym_size; i++)
-    for (j = 0; j < mod; j++) {
-      if (pos[i] & (1 << j)) {
+    for (w = pos[i] | neg[i]; w; w &= w - 1) {
+      n = mod * i + __builtin_ctzll(w);
+      if (pos[i] & bit(n)) {
         if (!start)
           fprintf(tl_out, " && ");
-        fprintf(tl_out, "%s", sym_table[mod * i + j]);
+        fprintf(tl_out, "%s", sym_table[n]);
         start = 0;
       }
-      if (neg[i] & (1 << j)) {
+      if (neg[i] & bit(n)) {
         if (!start)
           fprintf(tl_out, " && ");
-        fprintf(tl_out, "!%s", sym_table[mod * i + j]);
+        fprintf(tl_out, "!%s", sym_table[n]);
         start = 0;
       }
     }
@@ -146,56 +578,53 @@ void spin_print_set(int *pos,
     fprintf(tl_out, "1");
 }
 
-void spin_sprint_set(char *buffer, int *pos,
-                     int *neg) /* prints the content of a set for spin */
+void spin_sprint_set(char *buffer, uint64_t *pos,
+                     uint64_t *neg) /* prints the content of a set for spin */
 {
-  int i, j, start_pos = 1, start_neg = 1;
+  int start_pos = 1, start_neg = 1, n;
   char *p = buffer; // pointer to the current position in the buffer
+  SetIter it;
 
   p += sprintf(p, "Pos(");
 
-  for (i = 0; i < sym_size; i++)
-    for (j = 0; j < mod; j++) {
-      if (pos[i] & (1 << j)) {
-        if (!start_pos)
-          p += sprintf(p, " && ");
-        p += sprintf(p, "%s", sym_table[mod * i + j]);
-        start_pos = 0;
-      }
-    }
+  for (first_elem(&it, pos, 1); (n = next_elem(&it)) >= 0;) {
+    if (!start_pos)
+      p += sprintf(p, " && ");
+    p += sprintf(p, "%s", sym_table[n]);
+    start_pos = 0;
+  }
 
   p += sprintf(p, "), Neg(");
 
-  for (i = 0; i < sym_size; i++)
-    for (j = 0; j < mod; j++) {
-      if (neg[i] & (1 << j)) {
-        if (!start_neg)
-          p += sprintf(p, " && ");
-        p += sprintf(p, "%s", sym_table[mod * i + j]);
-        start_neg = 0;
-      }
-    }
+  for (first_elem(&it, neg, 1); (n = next_elem(&it)) >= 0;) {
+    if (!start_neg)
+      p += sprintf(p, " && ");
+    p += sprintf(p, "%s", sym_table[n]);
+    start_neg = 0;
+  }
 
   sprintf(p, ")");
 }
 
-cJSON *conditions_to_json_array(int *pos, int *neg) {
-  int i, j, start_pos = 1, start_neg = 1;
+cJSON *conditions_to_json_array(uint64_t *pos, uint64_t *neg) {
+  int i, n, start_pos = 1, start_neg = 1;
   char pos_str[1024] = "", neg_str[1024] = "";
+  uint64_t w;
 
   for (i = 0; i < sym_size; i++)
-    for (j = 0; j < mod; j++) {
-      if (pos[i] & (1 << j)) {
+    for (w = pos[i] | neg[i]; w; w &= w - 1) {
+      n = mod * i + __builtin_ctzll(w);
+      if (pos[i] & bit(n)) {
         if (!start_pos)
           strcat(pos_str, " && ");
-        strcat(pos_str, sym_table[mod * i + j]);
+        strcat(pos_str, sym_table[n]);
         start_pos = 0;
       }
-      if (neg[i] & (1 << j)) {
+      if (neg[i] & bit(n)) {
         if (!start_neg)
           strcat(neg_str, " && ");
         strcat(neg_str, "!");
-        strcat(neg_str, sym_table[mod * i + j]);
+        strcat(neg_str, sym_table[n]);
         start_neg = 0;
       }
     }
@@ -212,77 +641,275 @@ cJSON *conditions_to_json_array(int *pos, int *neg) {
   return conditions;
 }
 
-void print_set(int *l, int type) /* prints the content of a set */
+void print_set(uint64_t *l, int type) /* prints the content of a set */
 {
-  int i, j, start = 1;
-  ;
+  int n, start = 1;
+  SetIter it;
   if (type != 1)
     fprintf(tl_out, "{");
-  for (i = 0; i < set_size(type); i++)
-    for (j = 0; j < mod; j++)
-      if (l[i] & (1 << j)) {
-        switch (type) {
-        case 0:
-        case 2:
-          if (!start)
-            fprintf(tl_out, ",");
-          fprintf(tl_out, "%i", mod * i + j);
-          break;
-        case 1:
-          if (!start)
-            fprintf(tl_out, " & ");
-          fprintf(tl_out, "%s", sym_table[mod * i + j]);
-          break;
-        }
-        start = 0;
-      }
+  for (first_elem(&it, l, type); (n = next_elem(&it)) >= 0;) {
+    switch (type) {
+    case 0:
+    case 2:
+      if (!start)
+        fprintf(tl_out, ",");
+      fprintf(tl_out, "%i", n);
+      break;
+    case 1:
+      if (!start)
+        fprintf(tl_out, " & ");
+      fprintf(tl_out, "%s", sym_table[n]);
+      break;
+    }
+    start = 0;
+  }
   if (type != 1)
     fprintf(tl_out, "}");
 }
 
-int empty_set(int *l, int type) /* tests if a set is the empty set */
+int empty_set(uint64_t *l, int type) /* tests if a set is the empty set */
 {
-  int i, test = 0;
-  for (i = 0; i < set_size(type); i++)
-    test |= l[i];
-  return !test;
+  return set_ops[type].empty(l, set_ops[type].size);
 }
 
-int same_sets(int *l1, int *l2, int type) /* tests if two sets are identical */
+int same_sets(uint64_t *l1, uint64_t *l2,
+              int type) /* tests if two sets are identical */
 {
-  int i, test = 1;
-  for (i = 0; i < set_size(type); i++)
-    test &= (l1[i] == l2[i]);
-  return test;
+  return set_ops[type].same(l1, l2, set_ops[type].size);
 }
 
 int included_set(
-    int *l1, int *l2,
+    uint64_t *l1, uint64_t *l2,
     int type) { /* tests if the first set is included in the second one */
-  int i, test = 0;
+  return set_ops[type].included(l1, l2, set_ops[type].size);
+}
+
+unsigned long hash_set(uint64_t *l, int type) /* hashes the content of a set */
+{
+  int i;
+  unsigned long h = 14695981039346656037UL;
   for (i = 0; i < set_size(type); i++)
-    test |= (l1[i] & ~l2[i]);
-  return !test;
+    h = (h ^ l[i]) * 1099511628211UL;
+  return h;
+}
+
+unsigned long hash_label(uint64_t *l) /* hashes a label pos|neg */
+{
+  return hash_set(l, 1) * 31 + hash_set(l + sym_size, 1);
 }
 
-int in_set(int *l, int n) /* tests if an element is in a set */
+int in_set(uint64_t *l, int n) /* tests if an element is in a set */
 {
-  return (l[n / mod] & (1 << (n % mod)));
+  return (l[n / mod] & bit(n)) != 0;
 }
 
-int *list_set(int *l, int type) /* transforms a set into a list */
+int *list_set(uint64_t *l, int type) /* transforms a set into a list */
 {
-  int i, j, size = 1, *list;
+  int i, size = 1, *list;
   for (i = 0; i < set_size(type); i++)
-    for (j = 0; j < mod; j++)
-      if (l[i] & (1 << j))
-        size++;
+    size += __builtin_popcountll(l[i]);
   list = (int *)tl_emalloc(size * sizeof(int));
   list[0] = size;
-  size = 1;
-  for (i = 0; i < set_size(type); i++)
-    for (j = 0; j < mod; j++)
-      if (l[i] & (1 << j))
-        list[size++] = mod * i + j;
+  fill_list(l, type, list + 1, 0);
   return list;
 }
+
+int fill_list(uint64_t *l, int type, int *list,
+              int offset) /* writes the elements of a set, shifted by offset,
+                             in list and returns their number */
+{
+  int n, size = 0;
+  SetIter it;
+  for (first_elem(&it, l, type); (n = next_elem(&it)) >= 0;)
+    list[size++] = n + offset;
+  return size;
+}
+
+/********************************************************************\
+|*               Packed sets, for the states of automata            *|
+\********************************************************************/
+
+/* a packed set is kept as the sorted list of its elements when it has few
+   of them compared to the width of the sets, and as a bitset otherwise; the
+   first word is the number of elements of a list, or DENSE for a bitset.
+   The memory and the comparisons of a sparse set follow its number of
+   elements instead of the number of nodes of the formula */
+
+#define DENSE (~(uint64_t)0)
+#define sparse(n, size) (((n) + 1) / 2 < (size)) /* the list is smaller */
+
+int count_set(uint64_t *l, int type) /* the number of elements of a set */
+{
+  int i, n = 0;
+  for (i = 0; i < set_size(type); i++)
+    n += __builtin_popcountll(l[i]);
+  return n;
+}
+
+uint64_t *pack_set(uint64_t *l, int type) /* a packed copy of a set */
+{
+  int n = count_set(l, type);
+  uint64_t *p;
+  if (!sparse(n, set_size(type))) {
+    p = (uint64_t *)slab_alloc((set_size(type) + 1) * sizeof(uint64_t));
+    p[0] = DENSE;
+    copy_set(l, p + 1, type);
+    return p;
+  }
+  p = (uint64_t *)slab_alloc((1 + (n + 1) / 2) * sizeof(uint64_t));
+  p[0] = n;
+  fill_list(l, type, (int *)(p + 1), 0);
+  return p;
+}
+
+void free_packed(uint64_t *p, int type) /* frees a set made by pack_set */
+{
+  int n = p[0] == DENSE ? set_size(type) + 1 : 1 + ((int)p[0] + 1) / 2;
+  slab_free(p, n * sizeof(uint64_t));
+}
+
+void unpack_set(uint64_t *p, uint64_t *l,
+                int type) /* writes a packed set as a bitset */
+{
+  int i, *elem = (int *)(p + 1);
+  if (p[0] == DENSE) {
+    copy_set(p + 1, l, type);
+    return;
+  }
+  clear_set(l, type);
+  for (i = 0; i < (int)p[0]; i++)
+    add_set(l, elem[i]);
+}
+
+int same_packed(uint64_t *p, uint64_t *l, int n,
+                int type) /* tests if a packed set is equal to the set l,
+                             which has n elements */
+{
+  int i, *elem = (int *)(p + 1);
+  if (p[0] == DENSE)
+    return same_sets(p + 1, l, type);
+  if ((int)p[0] != n)
+    return 0;
+  for (i = 0; i < n; i++)
+    if (!in_set(l, elem[i]))
+      return 0;
+  return 1;
+}
+
+/********************************************************************\
+|*         Labels of the generalized and Buchi automata             *|
+\********************************************************************/
+
+/* each label pos|neg of a transition is stored once: the transitions
+   refer to it by its id, so that two labels are equal if their ids are,
+   and the inclusions between wide labels are remembered by pair of ids */
+
+#define CACHED_LABEL 8 /* narrower labels are compared directly, which is
+                          cheaper than looking the pair up */
+#define MAX_PAIRS (1 << 20)
+
+typedef struct LabelPair {
+  int a; /* 1 + id of the first label, 0 if the entry is free */
+  int b;
+  int included;
+} LabelPair;
+
+static uint64_t **label_table;
+static unsigned long *label_hashes;
+static int *label_slot; /* 1 + id of the label, by hash */
+static int label_count, label_slots;
+static LabelPair *pair_cache;
+static int pair_count, pair_size;
+
+static void grow_labels() /* doubles the table of the labels */
+{
+  int i, j, size = label_slots ? 2 * label_slots : 256;
+  uint64_t **table = (uint64_t **)tl_emalloc(size / 2 * sizeof(uint64_t *));
+  unsigned long *hashes =
+      (unsigned long *)tl_emalloc(size / 2 * sizeof(unsigned long));
+  if (label_slots) {
+    memcpy(table, label_table, label_count * sizeof(uint64_t *));
+    memcpy(hashes, label_hashes, label_count * sizeof(unsigned long));
+    tfree(label_table);
+    tfree(label_hashes);
+    tfree(label_slot);
+  }
+  label_table = table;
+  label_hashes = hashes;
+  label_slots = size;
+  label_slot = (int *)tl_emalloc(size * sizeof(int));
+  for (i = 0; i < label_count; i++) {
+    for (j = label_hashes[i] & (size - 1); label_slot[j];
+         j = (j + 1) & (size - 1))
+      ;
+    label_slot[j] = i + 1;
+  }
+}
+
+int intern_label(uint64_t *l) /* the id of the label pos|neg l */
+{
+  int i, id;
+  unsigned long h = hash_label(l);
+  if (2 * (label_count + 1) > label_slots)
+    grow_labels();
+  for (i = h & (label_slots - 1); (id = label_slot[i]);
+       i = (i + 1) & (label_slots - 1))
+    if (label_hashes[id - 1] == h && same_sets(label_table[id - 1], l, LABEL))
+      return id - 1;
+  label_table[label_count] = dup_set(l, LABEL);
+  label_hashes[label_count] = h;
+  label_slot[i] = ++label_count;
+  return label_count - 1;
+}
+
+uint64_t *label_set(int id) /* the sets pos|neg of a label */
+{
+  return label_table[id];
+}
+
+unsigned long label_hash(int id) { return label_hashes[id]; }
+
+static void grow_pairs() /* doubles the cache of the inclusions, or empties
+                            it once it is large */
+{
+  int i, j, size = pair_size ? 2 * pair_size : 1024;
+  LabelPair *old = pair_cache;
+  if (size > MAX_PAIRS) {
+    memset(pair_cache, 0, pair_size * sizeof(LabelPair));
+    pair_count = 0;
+    return;
+  }
+  pair_cache = (LabelPair *)tl_emalloc(size * sizeof(LabelPair));
+  for (i = 0; i < pair_size; i++)
+    if (old[i].a) {
+      for (j = (old[i].a * 31 + old[i].b) & (size - 1); pair_cache[j].a;
+           j = (j + 1) & (size - 1))
+        ;
+      pair_cache[j] = old[i];
+    }
+  if (old)
+    tfree(old);
+  pair_size = size;
+}
+
+int included_label(int a, int b) /* tests if the sets of label a are
+                                    included in the ones of label b */
+{
+  int i;
+  if (a == b)
+    return 1;
+  if (set_ops[LABEL].size <= CACHED_LABEL)
+    return set_ops[LABEL].included(label_table[a], label_table[b],
+                                   set_ops[LABEL].size);
+  if (2 * (pair_count + 1) > pair_size)
+    grow_pairs();
+  for (i = ((a + 1) * 31 + b) & (pair_size - 1); pair_cache[i].a;
+       i = (i + 1) & (pair_size - 1))
+    if (pair_cache[i].a == a + 1 && pair_cache[i].b == b)
+      return pair_cache[i].included;
+  pair_cache[i].a = a + 1;
+  pair_cache[i].b = b;
+  pair_cache[i].included = included_set(label_table[a], label_table[b], LABEL);
+  pair_count++;
+  return pair_cache[i].included;
+}
@@ -0,0 +1,139 @@
+/***** ltl2ba : setbench.c *****/
+
+/* Times the set predicates with each kernel of set.c, and with the       */
+/* operations specialized for the width of the sets, for several sizes   */
+/* of sets: make setbench && ./setbench                                   */
+/*                                                                        */
+/* This program is free software; you can redistribute it and/or modify   */
+/* it under the terms of the GNU General Public License as published by   */
+/* the Free Software Foundation; either version 2 of the License, or      */
+/* (at your option) any later version.                                    */
+
+#include "ltl2ba.h"
+#include <time.h>
+
+FILE *tl_out;
+int node_size, sym_size = 1, scc_size = 1;
+char **sym_table;
+
+#define PAIRS 512
+#define WORK (1 << 24) /* words read by each measure */
+
+void *tl_emalloc(int n) {
+  void *m = malloc(n);
+  if (!m) {
+    printf("setbench: not enough memory\n");
+    exit(1);
+  }
+  memset(m, 0, n);
+  return m;
+}
+
+void *slab_alloc(int n) { return tl_emalloc(n); }
+
+void slab_free(void *v, int n) { free(v); }
+
+void tfree(void *v) { free(v); }
+
+static uint64_t seed = 88172645463325252ULL;
+
+static uint64_t rand64() { /* xorshift */
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* the sets are chosen so that no predicate stops before the last word:
+   l1 is included in l2 and disjoint from l3, l0 is empty */
+
+static uint64_t *l0, *l1[PAIRS], *l2[PAIRS], *l3[PAIRS];
+static volatile int sink;
+
+static double run(int op, int rounds) { /* nanoseconds by call */
+  int i, r, s = 0;
+  double t = now();
+  for (r = 0; r < rounds; r++)
+    for (i = 0; i < PAIRS; i++)
+      switch (op) {
+      case 0:
+        s += included_set(l1[i], l2[i], 0);
+        break;
+      case 1:
+        s += same_sets(l1[i], l1[i], 0);
+        break;
+      case 2:
+        s += empty_intersect_sets(l1[i], l3[i], 0);
+        break;
+      case 3:
+        s += empty_set(l0, 0);
+        break;
+      case 4:
+        do_merge_sets(l3[i], l1[i], l2[i], 0);
+        break;
+      }
+  sink = s;
+  return (now() - t) / ((double)rounds * PAIRS);
+}
+
+static double measure(int op, int n) { /* the best of three runs */
+  int k, rounds = WORK / (PAIRS * n) + 1;
+  double t, best = run(op, rounds);
+  for (k = 0; k < 2; k++)
+    if ((t = run(op, rounds)) < best)
+      best = t;
+  return best;
+}
+
+int main() {
+  static char *ops[] = {"included", "same", "disjoint", "empty", "merge"};
+  static int widths[] = {1, 2, 4, 8, 16, 32, 64};
+  int i, j, k, w, op;
+  const char *name;
+  tl_out = stdout;
+
+  printf("%-9s %5s", "predicate", "words");
+  for (k = 0; k < 4; k++)
+    if ((name = use_set_kernel(k)))
+      printf(" %9s", name);
+  printf(" %9s   (ns by call)\n", "width");
+
+  for (w = 0; w < (int)(sizeof(widths) / sizeof(int)); w++) {
+    node_size = widths[w];
+    l0 = new_set(0);
+    for (i = 0; i < PAIRS; i++) {
+      l1[i] = new_set(0);
+      l2[i] = new_set(0);
+      l3[i] = new_set(0);
+      for (j = 0; j < node_size; j++) {
+        l1[i][j] = rand64() | 1;
+        l2[i][j] = l1[i][j] | rand64();
+        l3[i][j] = ~l2[i][j];
+      }
+    }
+    for (op = 0; op < 5; op++) {
+      printf("%-9s %5d", ops[op], node_size);
+      use_set_widths(0);
+      for (k = 0; k < 4; k++)
+        if (use_set_kernel(k))
+          printf(" %9.2f", measure(op, node_size));
+      use_set_widths(1); /* the operations specialized for the width, if
+                            any, with the widest kernel otherwise */
+      init_set_kernel();
+      printf(" %9.2f\n", measure(op, node_size));
+    }
+    for (i = 0; i < PAIRS; i++) {
+      free(l1[i]);
+      free(l2[i]);
+      free(l3[i]);
+    }
+    free(l0);
+  }
+  return 0;
+}
@@ -32,7 +32,7 @@
 
 #include "ltl2ba.h"
 
-extern int tl_verbose, tl_terse, tl_errs;
+extern int tl_verbose, tl_terse, tl_tgba, tl_errs;
 extern FILE *tl_out;
 
 int Stack_mx = 0, Max_Red = 0, Total = 0;
@@ -176,5 +176,9 @@ void trans(Node *p) {
 
   mk_alternating(p);
   mk_generalized();
-  mk_buchi();
+  if (tl_tgba) { /* no degeneralization */
+    dump_generalized_to_json();
+    print_hoa_generalized();
+  } else
+    mk_buchi();
 }
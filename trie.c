@@ -0,0 +1,126 @@
+/***** ltl2ba : trie.c *****/
+
+/* Written by Denis Oddoux, LIAFA, France                                 */
+/* Copyright (c) 2001  Denis Oddoux                                       */
+/* Modified by Paul Gastin, LSV, France                                   */
+/* Copyright (c) 2007  Paul Gastin                                        */
+/*                                                                        */
+/* This program is free software; you can redistribute it and/or modify   */
+/* it under the terms of the GNU General Public License as published by   */
+/* the Free Software Foundation; either version 2 of the License, or      */
+/* (at your option) any later version.                                    */
+/*                                                                        */
+/* This program is distributed in the hope that it will be useful,        */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/* GNU General Public License for more details.                           */
+/*                                                                        */
+/* You should have received a copy of the GNU General Public License      */
+/* along with this program; if not, write to the Free Software            */
+/* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA*/
+/*                                                                        */
+/* Based on the translation algorithm by Gastin and Oddoux,               */
+/* presented at the 13th International Conference on Computer Aided       */
+/* Verification, CAV 2001, Paris, France.                                 */
+/* Proceedings - LNCS 2102, pp. 53-65                                     */
+/*                                                                        */
+/* Send bug-reports and/or questions to Paul Gastin                       */
+/* http://www.lsv.ens-cachan.fr/~gastin                                   */
+
+#include "ltl2ba.h"
+
+/********************************************************************\
+|*      Set-trie: index of sets answering subset/superset queries   *|
+\********************************************************************/
+
+/* A set is stored as the path of its elements in increasing order,
+   each node keeping its children sorted. Keys are the element lists
+   built by the callers (see fill_list). */
+
+STrie *new_strie() /* creates an empty index */
+{
+  return (STrie *)slab_alloc(sizeof(STrie));
+}
+
+void free_strie(STrie *t) /* frees an index */
+{
+  STrie *c;
+  while ((c = t->child)) {
+    t->child = c->sibling;
+    free_strie(c);
+  }
+  slab_free(t, sizeof(STrie));
+}
+
+STrie *strie_insert(STrie *t, int *key, int n,
+                    void *item) /* stores the set 'key' with its item */
+{
+  STrie **c;
+  for (; n > 0; key++, n--) {
+    for (c = &t->child; *c && (*c)->elem < *key; c = &(*c)->sibling)
+      ;
+    if (!*c || (*c)->elem != *key) {
+      STrie *tmp = (STrie *)slab_alloc(sizeof(STrie));
+      tmp->elem = *key;
+      tmp->parent = t;
+      tmp->sibling = *c;
+      *c = tmp;
+    }
+    t = *c;
+  }
+  t->item = item;
+  return t;
+}
+
+void strie_remove(STrie *t) /* removes the set ending at t */
+{
+  STrie **c, *p;
+  t->item = (void *)0;
+  while ((p = t->parent) && !t->item && !t->child) { /* prunes empty nodes */
+    for (c = &p->child; *c != t; c = &(*c)->sibling)
+      ;
+    *c = t->sibling;
+    slab_free(t, sizeof(STrie));
+    t = p;
+  }
+}
+
+void *strie_subset(STrie *t, int *key,
+                   int n) /* finds an item whose set is included in key */
+{
+  STrie *c;
+  void *result;
+  if (t->item)
+    return t->item;
+  for (c = t->child; c; c = c->sibling) {
+    while (n > 0 && *key < c->elem)
+      key++, n--;
+    if (n == 0)
+      break;
+    if (*key == c->elem && (result = strie_subset(c, key + 1, n - 1)))
+      return result;
+  }
+  return (void *)0;
+}
+
+static void supersets(STrie *t, int *key, int n, STrie **result) {
+  STrie *c;
+  if (n == 0 && t->item) {
+    t->found = *result;
+    *result = t;
+  }
+  for (c = t->child; c && (n == 0 || c->elem <= *key); c = c->sibling)
+    if (n > 0 && c->elem == *key)
+      supersets(c, key + 1, n - 1, result);
+    else
+      supersets(c, key, n, result);
+}
+
+STrie *strie_supersets(STrie *t, int *key,
+                       int n) /* lists the sets including key, through the
+                                 'found' field of their last node */
+{
+  STrie *result = (STrie *)0;
+  supersets(t, key, n, &result);
+  return result;
+}